@@ -3,6 +3,7 @@ import os
 import numpy as np
 
 from pdas.data_utils import load_meshes, decompose_domain_data, write_to_binary
+from pdas_exp.snapshot_io import is_snapshot_file, load_snapshot
 
 # ----- START USER INPUTS -----
 
@@ -51,9 +52,14 @@ for param_idx, param in enumerate(param_list):
     # load snapshot
     casedir = casename.format(param=param)
     infile = os.path.join(datadir_base, casedir, datafile)
-    data = np.fromfile(infile, dtype=np.float64)
-    data = np.reshape(data, (nvars, ncellsX, ncellsY, -1), order="F")
-    data_snap = data[:, :, :, ic_idx]
+    if is_snapshot_file(infile):
+        # only reads the requested snapshot, IC files are always double precision
+        data_snap = load_snapshot(infile, ic_idx).astype(np.float64)
+        data_snap = np.reshape(data_snap, (nvars, ncellsX, ncellsY), order="F")
+    else:
+        data = np.fromfile(infile, dtype=np.float64)
+        data = np.reshape(data, (nvars, ncellsX, ncellsY, -1), order="F")
+        data_snap = data[:, :, :, ic_idx]
 
     if (ndomX == 1) and (ndomY == 1):
         outdir = os.path.join(outdir_base, order)
@@ -0,0 +1,255 @@
+#ifndef PDAS_EXPERIMENTS_BARRIERS_HPP_
+#define PDAS_EXPERIMENTS_BARRIERS_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined SCHWARZ_ENABLE_OMP
+#include <omp.h>
+#endif
+
+/*
+    Time each thread spends working vs waiting at the explicit barriers of the decomposed time loop:
+
+        {
+            BarrierWait wait(barriers, barrierIdx);
+            #pragma omp barrier
+        }
+
+    A step runs from one departure of the step-ending barrier to the next. A thread's busy time in a
+    step is the step minus its waits, and the step's imbalance is max / mean busy time over threads.
+    Waits at barriers inside pda-schwarz (the implicit ones closing its omp for loops) count as busy.
+    With decomp: barrierFile set in the input, the report is written as JSON at the end of the run:
+
+    {"version": 1, "numThreads": 4, "busySeconds": [...per thread],
+     "barriers": [{"name": "controller", "waitSeconds": [...per thread]}, ...],
+     "meanImbalance": 1.3, "maxImbalance": 2.1, "imbalanceSeconds": 12.5,
+     "steps": [{"step": 1, "imbalance": 1.2, "maxBusy": 0.31, "meanBusy": 0.26}, ...]}
+
+    imbalanceSeconds sums max - mean busy time over steps, the wall time a perfectly balanced
+    schedule of the same work would save. Without a file, collect keeps the per-step waits that
+    stepWait() reports, e.g. for runtime.bin, and writes nothing.
+*/
+
+using barrier_clock_t = std::chrono::steady_clock;
+
+// one thread's accounting, written only by that thread; published steps are read by the master
+struct alignas(64) BarrierThreadSlot
+{
+    barrier_clock_t::time_point stepStart;
+    barrier_clock_t::time_point arrival;
+    double stepWait = 0.0;
+    double published[2] = {};       // busy seconds of the last two steps, by step parity
+    double publishedWait[2] = {};   // wait seconds of the same steps
+    double busyTotal = 0.0;
+    std::vector<double> waitTotals; // per barrier
+};
+
+struct BarrierStepRecord
+{
+    std::int64_t step;
+    double imbalance;
+    double maxBusy;
+    double meanBusy;
+};
+
+class BarrierProfiler
+{
+public:
+    // an empty file name disables the profiler; construct outside the parallel region.
+    // Slots are allocated for the most threads the region can get, start() records how many it got
+    BarrierProfiler(const std::string & f0, std::vector<std::string> barrierNames, int numSteps, bool collect = false)
+        : fileName_(f0), barrierNames_(std::move(barrierNames))
+    {
+        if (f0.empty() && !collect) return;
+        enabled_ = true;
+        int maxThreads = 1;
+#if defined SCHWARZ_ENABLE_OMP
+        maxThreads = omp_get_max_threads();
+#endif
+        slots_ = std::vector<BarrierThreadSlot>(maxThreads);
+        for (auto & slot : slots_) slot.waitTotals.assign(barrierNames_.size(), 0.0);
+        if (!f0.empty()) records_.reserve(std::max(numSteps, 0));
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // the most threads the region can get, 0 if disabled
+    int maxThreads() const { return static_cast<int>(slots_.size()); }
+
+    // seconds a thread waited in a step, read like the values commit() records; NaN outside the team
+    double stepWait(int threadIdx, std::int64_t step) const
+    {
+        if (threadIdx >= numThreads_) return std::numeric_limits<double>::quiet_NaN();
+        return slots_[threadIdx].publishedWait[step % 2];
+    }
+
+    static int thread_index()
+    {
+#if defined SCHWARZ_ENABLE_OMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    // every thread, entering the time loop; the team size is only read by the master thread
+    void start()
+    {
+        if (!enabled_) return;
+        const int threadIdx = thread_index();
+#if defined SCHWARZ_ENABLE_OMP
+        if (threadIdx == 0) numThreads_ = omp_get_num_threads();
+#endif
+        slots_[threadIdx].stepStart = barrier_clock_t::now();
+    }
+
+    void arrive()
+    {
+        slots_[thread_index()].arrival = barrier_clock_t::now();
+    }
+
+    // after the barrier; the step-ending barrier publishes the thread's step under the step's parity
+    void depart(int barrierIdx, bool endsStep, std::int64_t step)
+    {
+        auto & slot = slots_[thread_index()];
+        const auto now = barrier_clock_t::now();
+        const double wait = std::chrono::duration<double>(now - slot.arrival).count();
+        slot.stepWait += wait;
+        slot.waitTotals[barrierIdx] += wait;
+        if (!endsStep) return;
+
+        const double busy = std::chrono::duration<double>(now - slot.stepStart).count() - slot.stepWait;
+        slot.busyTotal += busy;
+        slot.published[step % 2] = busy;
+        slot.publishedWait[step % 2] = slot.stepWait;
+        slot.stepStart = now;
+        slot.stepWait = 0.0;
+    }
+
+    // master thread, once per step after the step-ending barrier; records the previous step,
+    // whose published values no thread writes to again before the next barrier
+    void commit(std::int64_t step)
+    {
+        if (!enabled_) return;
+        if (pendingStep_ >= 0) record(pendingStep_);
+        pendingStep_ = step;
+    }
+
+    // after the parallel region
+    void finish()
+    {
+        if (!enabled_) return;
+        if (pendingStep_ >= 0) record(pendingStep_);
+        pendingStep_ = -1;
+    }
+
+    void write() const
+    {
+        if (!enabled_ || fileName_.empty()) return;
+        std::ofstream fout(fileName_);
+        if (!fout) throw std::runtime_error("Could not open " + fileName_);
+
+        auto write_threads = [&](auto value) {
+            fout << "[";
+            for (int threadIdx = 0; threadIdx < numThreads_; ++threadIdx) {
+                fout << (threadIdx ? ", " : "") << value(slots_[threadIdx]);
+            }
+            fout << "]";
+        };
+
+        double sumImbalance = 0.0;
+        double maxImbalance = 0.0;
+        double imbalanceSecs = 0.0;
+        for (const auto & rec : records_) {
+            sumImbalance += rec.imbalance;
+            maxImbalance = std::max(maxImbalance, rec.imbalance);
+            imbalanceSecs += rec.maxBusy - rec.meanBusy;
+        }
+        const double meanImbalance = records_.empty() ? 0.0 : sumImbalance / records_.size();
+
+        fout << "{\"version\": 1, \"numThreads\": " << numThreads_ << ", \"busySeconds\": ";
+        write_threads([](const BarrierThreadSlot & slot) { return slot.busyTotal; });
+        fout << ",\n\"barriers\": [";
+        for (std::size_t barrierIdx = 0; barrierIdx < barrierNames_.size(); ++barrierIdx) {
+            fout << (barrierIdx ? ", " : "") << "{\"name\": \"" << barrierNames_[barrierIdx] << "\", \"waitSeconds\": ";
+            write_threads([&](const BarrierThreadSlot & slot) { return slot.waitTotals[barrierIdx]; });
+            fout << "}";
+        }
+        fout << "],\n\"meanImbalance\": " << meanImbalance << ", \"maxImbalance\": " << maxImbalance
+            << ", \"imbalanceSeconds\": " << imbalanceSecs << ",\n\"steps\": [";
+        for (std::size_t recIdx = 0; recIdx < records_.size(); ++recIdx) {
+            const auto & rec = records_[recIdx];
+            fout << (recIdx ? ",\n" : "\n") << "{\"step\": " << rec.step << ", \"imbalance\": " << rec.imbalance
+                << ", \"maxBusy\": " << rec.maxBusy << ", \"meanBusy\": " << rec.meanBusy << "}";
+        }
+        fout << "]}\n";
+
+        double busy = 0.0;
+        double wait = 0.0;
+        for (int threadIdx = 0; threadIdx < numThreads_; ++threadIdx) {
+            busy += slots_[threadIdx].busyTotal;
+            for (const auto secs : slots_[threadIdx].waitTotals) wait += secs;
+        }
+        std::cout << fileName_ << ": threads waited at barriers " << ((busy + wait > 0.0) ? 100.0 * wait / (busy + wait) : 0.0)
+            << "% of the time, mean imbalance (max/mean busy) " << meanImbalance
+            << ", a balanced schedule would save " << imbalanceSecs << " s" << std::endl;
+    }
+
+private:
+    void record(std::int64_t step)
+    {
+        if (fileName_.empty()) return;
+        double maxBusy = 0.0;
+        double sumBusy = 0.0;
+        for (int threadIdx = 0; threadIdx < numThreads_; ++threadIdx) {
+            const double busy = slots_[threadIdx].published[step % 2];
+            maxBusy = std::max(maxBusy, busy);
+            sumBusy += busy;
+        }
+        const double meanBusy = sumBusy / numThreads_;
+        records_.push_back({step, (meanBusy > 0.0) ? maxBusy / meanBusy : 1.0, maxBusy, meanBusy});
+    }
+
+    bool enabled_ = false;
+    std::string fileName_;
+    std::vector<std::string> barrierNames_;
+    int numThreads_ = 1;                        // threads in the team, set by start()
+    std::vector<BarrierThreadSlot> slots_;      // one per thread the team can have
+    std::vector<BarrierStepRecord> records_;    // reserved for every step up front
+    std::int64_t pendingStep_ = -1;
+};
+
+// wraps one barrier: arrival on construction, departure on destruction
+class BarrierWait
+{
+public:
+    BarrierWait(BarrierProfiler & profiler, int barrierIdx, bool endsStep = false, std::int64_t step = 0)
+        : profiler_(profiler.enabled() ? &profiler : nullptr), barrierIdx_(barrierIdx), endsStep_(endsStep), step_(step)
+    {
+        if (profiler_) profiler_->arrive();
+    }
+
+    BarrierWait(const BarrierWait &) = delete;
+    BarrierWait & operator=(const BarrierWait &) = delete;
+
+    ~BarrierWait()
+    {
+        if (profiler_) profiler_->depart(barrierIdx_, endsStep_, step_);
+    }
+
+private:
+    BarrierProfiler * profiler_;
+    int barrierIdx_;
+    bool endsStep_;
+    std::int64_t step_;
+};
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef PDAS_EXPERIMENTS_CHECKPOINT_HPP_
+#define PDAS_EXPERIMENTS_CHECKPOINT_HPP_
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "progress.hpp"
+#include "solver_telemetry.hpp"
+#include "timers.hpp"
+
+// Checkpoint/restart settings; checkpoints are written periodically and on SIGTERM/SIGUSR1
+struct CheckpointConfig
+{
+    bool enabled = false;               // checkpointFile or checkpointInterval given
+    double interval = 0.0;              // wall-clock seconds between checkpoints, 0: on signal only
+    std::string file = "checkpoint.bin";
+    std::string restartFile = "";       // resume from this checkpoint
+};
+
+// flushes a file, or a directory's entries, to stable storage
+inline void fsync_path(const std::string & path, bool directory = false)
+{
+    const int fd = ::open(path.c_str(), directory ? (O_RDONLY | O_DIRECTORY) : O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open " + path + " to sync it");
+    const bool synced = (::fsync(fd) == 0);
+    ::close(fd);
+    if (!synced) throw std::runtime_error("Could not sync " + path);
+}
+
+// set by the signal handler, polled by the time loop between steps
+inline volatile std::sig_atomic_t checkpoint_signal = 0;
+
+inline void checkpoint_signal_handler(int signum) { checkpoint_signal = signum; }
+
+/*
+    Checkpoint file:
+    header: char magic[8] "PDASCKPT", std::uint32_t version, std::uint32_t reserved, std::int64_t step, double time
+    std::uint64_t numVectors, then per vector: std::uint64_t length, double x length
+    std::uint64_t numFiles, then per file: std::uint64_t nameLength, char x nameLength, std::uint64_t size
+    std::uint64_t numSums, then per entry: std::uint64_t nameLength, char x nameLength,
+        std::uint64_t length, double x length
+    The files are the run's outputs and their size when the checkpoint was taken, the sums are
+    running totals an output reports at the end of the run, by file name. Version 1 files have no sums.
+*/
+struct Checkpoint
+{
+    static constexpr char magic[8] = {'P', 'D', 'A', 'S', 'C', 'K', 'P', 'T'};
+    static constexpr std::uint32_t version = 2;
+
+    std::int64_t step = 0;
+    double time = 0.0;
+    std::vector<std::vector<double>> vectors;
+    std::vector<std::pair<std::string, std::uint64_t>> files;
+    std::vector<std::pair<std::string, std::vector<double>>> sums;
+
+    // whether the output file f0 is one a restart continues
+    bool hasFile(const std::string & f0) const
+    {
+        for (const auto & file : files) {
+            if (file.first == f0) return true;
+        }
+        return false;
+    }
+
+    // sums saved for the output file f0, nullptr if there are none
+    const std::vector<double> * findSums(const std::string & f0) const
+    {
+        for (const auto & entry : sums) {
+            if (entry.first == f0) return &entry.second;
+        }
+        return nullptr;
+    }
+
+    template<class VectorType>
+    void addVector(const VectorType & vec)
+    {
+        vectors.emplace_back(vec.size());
+        for (int i = 0; i < vec.size(); ++i) vectors.back()[i] = vec(i);
+    }
+
+    template<class VectorType>
+    void copyVector(std::size_t idx, VectorType & vec) const
+    {
+        if (idx >= vectors.size()) {
+            throw std::runtime_error("Checkpoint: no vector " + std::to_string(idx));
+        }
+        if (vectors[idx].size() != static_cast<std::size_t>(vec.size())) {
+            throw std::runtime_error("Checkpoint: vector " + std::to_string(idx) + " has length "
+                + std::to_string(vectors[idx].size()) + ", expected " + std::to_string(vec.size()));
+        }
+        for (int i = 0; i < vec.size(); ++i) vec(i) = vectors[idx][i];
+    }
+
+    // written next to the target, synced and renamed, so an interrupted write or a crash
+    // leaves either the previous checkpoint or the complete new one
+    void save(const std::string & f0) const
+    {
+        const std::string tmpFile = f0 + ".tmp";
+        {
+            std::ofstream fout(tmpFile, std::ios::out | std::ios::binary);
+            if (!fout) throw std::runtime_error("Could not open " + tmpFile);
+
+            const std::uint32_t head[2] = {version, 0};
+            fout.write(magic, sizeof(magic));
+            fout.write(reinterpret_cast<const char*>(head), sizeof(head));
+            fout.write(reinterpret_cast<const char*>(&step), sizeof(std::int64_t));
+            fout.write(reinterpret_cast<const char*>(&time), sizeof(double));
+
+            write_u64(fout, vectors.size());
+            for (const auto & vec : vectors) {
+                write_u64(fout, vec.size());
+                fout.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(double));
+            }
+            write_u64(fout, files.size());
+            for (const auto & file : files) {
+                write_u64(fout, file.first.size());
+                fout.write(file.first.data(), file.first.size());
+                write_u64(fout, file.second);
+            }
+            write_u64(fout, sums.size());
+            for (const auto & entry : sums) {
+                write_u64(fout, entry.first.size());
+                fout.write(entry.first.data(), entry.first.size());
+                write_u64(fout, entry.second.size());
+                fout.write(reinterpret_cast<const char*>(entry.second.data()), entry.second.size() * sizeof(double));
+            }
+            fout.flush();
+            if (!fout) throw std::runtime_error("Failed writing to " + tmpFile);
+        }
+        fsync_path(tmpFile);
+        if (std::rename(tmpFile.c_str(), f0.c_str()) != 0) {
+            throw std::runtime_error("Could not replace " + f0);
+        }
+        // the rename itself is only durable once the directory is
+        const auto slash = f0.find_last_of('/');
+        fsync_path((slash == std::string::npos) ? "." : ((slash == 0) ? "/" : f0.substr(0, slash)), true);
+    }
+
+    static Checkpoint load(const std::string & f0)
+    {
+        std::ifstream fin(f0, std::ios::in | std::ios::binary);
+        if (!fin) throw std::runtime_error("Could not open " + f0);
+
+        char fileMagic[8];
+        std::uint32_t head[2];
+        fin.read(fileMagic, sizeof(fileMagic));
+        fin.read(reinterpret_cast<char*>(head), sizeof(head));
+        if (!fin || (std::memcmp(fileMagic, magic, 8) != 0)) {
+            throw std::runtime_error(f0 + " is not a checkpoint file");
+        }
+        if (head[0] > version) {
+            throw std::runtime_error(f0 + " has unsupported checkpoint version " + std::to_string(head[0]));
+        }
+
+        Checkpoint ckpt;
+        fin.read(reinterpret_cast<char*>(&ckpt.step), sizeof(std::int64_t));
+        fin.read(reinterpret_cast<char*>(&ckpt.time), sizeof(double));
+        ckpt.vectors.resize(read_u64(fin));
+        for (auto & vec : ckpt.vectors) {
+            vec.resize(read_u64(fin));
+            fin.read(reinterpret_cast<char*>(vec.data()), vec.size() * sizeof(double));
+        }
+        ckpt.files.resize(read_u64(fin));
+        for (auto & file : ckpt.files) {
+            file.first.resize(read_u64(fin));
+            fin.read(&file.first[0], file.first.size());
+            file.second = read_u64(fin);
+        }
+        if (head[0] >= 2) {
+            ckpt.sums.resize(read_u64(fin));
+            for (auto & entry : ckpt.sums) {
+                entry.first.resize(read_u64(fin));
+                fin.read(&entry.first[0], entry.first.size());
+                entry.second.resize(read_u64(fin));
+                fin.read(reinterpret_cast<char*>(entry.second.data()), entry.second.size() * sizeof(double));
+            }
+        }
+        if (!fin) throw std::runtime_error("Failed reading " + f0);
+        return ckpt;
+    }
+
+private:
+    static void write_u64(std::ofstream & fout, std::uint64_t val)
+    {
+        fout.write(reinterpret_cast<const char*>(&val), sizeof(std::uint64_t));
+    }
+
+    static std::uint64_t read_u64(std::ifstream & fin)
+    {
+        std::uint64_t val = 0;
+        fin.read(reinterpret_cast<char*>(&val), sizeof(std::uint64_t));
+        return val;
+    }
+};
+
+// drop whatever the interrupted run wrote past the checkpoint, the resumed run appends from there
+inline void truncate_output_files(const Checkpoint & ckpt)
+{
+    for (const auto & file : ckpt.files) {
+        if (::truncate(file.first.c_str(), static_cast<off_t>(file.second)) != 0) {
+            throw std::runtime_error("Could not truncate " + file.first + " for restart");
+        }
+    }
+}
+
+// Decides when to checkpoint and holds the checkpoint a run restarts from.
+// SIGUSR1 checkpoints and continues, SIGTERM checkpoints and asks the time loop to stop.
+class CheckpointManager
+{
+public:
+    explicit CheckpointManager(const CheckpointConfig & config)
+        : config_(config), last_(std::chrono::steady_clock::now())
+    {
+        if (!config_.restartFile.empty()) {
+            restart_ = Checkpoint::load(config_.restartFile);
+            restarting_ = true;
+            std::cout << "Restarting from " << config_.restartFile << " at step " << restart_.step << std::endl;
+        }
+        if (config_.enabled) {
+            checkpoint_signal = 0;
+            std::signal(SIGTERM, checkpoint_signal_handler);
+            std::signal(SIGUSR1, checkpoint_signal_handler);
+        }
+    }
+
+    CheckpointManager(const CheckpointManager &) = delete;
+    CheckpointManager & operator=(const CheckpointManager &) = delete;
+
+    ~CheckpointManager()
+    {
+        if (config_.enabled) {
+            std::signal(SIGTERM, SIG_DFL);
+            std::signal(SIGUSR1, SIG_DFL);
+        }
+    }
+
+    bool enabled()                    const { return config_.enabled; }
+    bool restarting()                 const { return restarting_; }
+    const Checkpoint & restart()      const { return restart_; }
+    const Checkpoint * restartOrNull() const { return restarting_ ? &restart_ : nullptr; }
+    std::int64_t startStep()          const { return restarting_ ? restart_.step : 0; }
+    double startTime()                const { return restarting_ ? restart_.time : 0.0; }
+    bool stopRequested()              const { return stop_; }
+
+    bool due() const
+    {
+        if (!config_.enabled) return false;
+        if (checkpoint_signal != 0) return true;
+        if (config_.interval <= 0.0) return false;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - last_;
+        return elapsed.count() >= config_.interval;
+    }
+
+    void write(const Checkpoint & ckpt)
+    {
+        ckpt.save(config_.file);
+        std::cout << "Checkpoint at step " << ckpt.step << " written to " << config_.file << std::endl;
+        last_ = std::chrono::steady_clock::now();
+        if (checkpoint_signal == SIGTERM) {
+            std::cout << "Stopping after checkpoint" << std::endl;
+            stop_ = true;
+        }
+        checkpoint_signal = 0;
+    }
+
+private:
+    CheckpointConfig config_;
+    std::chrono::steady_clock::time_point last_;
+    bool restarting_ = false;
+    bool stop_ = false;
+    Checkpoint restart_;
+};
+
+/*
+    pressio::ode::advance_n_steps for implicit steppers, with checkpoints.
+    A checkpoint holds the state and, for BDF2, the state one step earlier; on restart the
+    stepper's stored previous state is rebuilt by replaying its startup step from that state,
+    so the resumed trajectory is bitwise identical to an uninterrupted one. The replay counts in no
+    perfCountersFile phase, and solverStats is reset after it so the first record holds only its own step.
+    outputs(ckpt) flushes the observers and adds their files, with the sizes to restart from, and sums to ckpt.
+    runtime(step, notApplicable, nonlinearIters, {solve, observers, checkpoint}) gets each step's
+    nonlinear iterations, read from solverStats before the observers reset them, and wall-clock
+    seconds, a checkpoint being counted in the record after it. The same times go to the timer registry.
+    progress is told about every step, progress.finish() is left to the caller.
+*/
+template<class StepperType, class StateType, class TimeType, class ObserverType, class SolverType,
+         class OutputsType, class RuntimeType>
+void advance_n_steps_checkpointed(StepperType & stepper, StateType & state, TimeType dt, int numSteps,
+                                  pressio::ode::StepScheme scheme, ObserverType & observer, SolverType & solver,
+                                  SolverStepStats & solverStats, CheckpointManager & manager,
+                                  OutputsType && outputs, RuntimeType & runtime, ProgressReporter & progress)
+{
+    using clock_t = std::chrono::high_resolution_clock;
+    auto seconds = [](clock_t::time_point start, clock_t::time_point end) {
+        return std::chrono::duration<double>(end - start).count();
+    };
+
+    namespace pode = pressio::ode;
+    const bool keepPrevious = (scheme == pode::StepScheme::BDF2);
+    StateType prevState = state;
+
+    auto & timers = TimerRegistry::instance();
+    const int startStep = static_cast<int>(manager.startStep());
+    if (manager.restarting()) {
+        ScopedTimer timer("restart");
+        const auto & ckpt = manager.restart();
+        ckpt.copyVector(0, state);
+        if (keepPrevious && (startStep > 0)) {
+            ckpt.copyVector(1, prevState);
+            StateType scratch = prevState;
+            PerfPause replayCounters;
+            stepper(scratch, pode::StepStartAt<TimeType>(static_cast<TimeType>(startStep - 1) * dt),
+                pode::StepCount(1), pode::StepSize<TimeType>(dt), solver);
+            solverStats = SolverStepStats();
+        }
+    }
+    else {
+        observer(pode::StepCount(0), static_cast<TimeType>(0), state);
+    }
+
+    auto & memory = MemoryRegistry::instance();
+    memory.startSteps();
+    double checkpointSecs = 0.0;
+    for (int step = startStep + 1; step <= numSteps; ++step) {
+        const auto solveStart = clock_t::now();
+        if (keepPrevious) prevState = state;
+        const std::uint32_t itersBefore = solverStats.nonlinearIters;
+        PerfScope solveCounters("solve");
+        const auto stepperStart = clock_t::now();
+        stepper(state, pode::StepStartAt<TimeType>(static_cast<TimeType>(step - 1) * dt),
+            pode::StepCount(step), pode::StepSize<TimeType>(dt), solver);
+        solverStats.stepSeconds = seconds(stepperStart, clock_t::now());
+        solveCounters.stop();
+        const std::uint64_t nonlinearIters = solverStats.nonlinearIters - itersBefore;
+        const auto time = static_cast<TimeType>(step) * dt;
+        const auto observerStart = clock_t::now();
+        PerfScope observerCounters("observers");
+        observer(pode::StepCount(step), time, state);
+        observerCounters.stop();
+        const auto observerEnd = clock_t::now();
+        runtime(step, RuntimeType::notApplicable, nonlinearIters, {seconds(solveStart, observerStart), seconds(observerStart, observerEnd), checkpointSecs});
+        timers.add("solve", seconds(solveStart, observerStart));
+        timers.add("observers", seconds(observerStart, observerEnd));
+        memory.recordStep(step);
+        progress(step, static_cast<double>(time));
+        checkpointSecs = 0.0;
+
+        if (manager.due()) {
+            const auto checkpointStart = clock_t::now();
+            const auto checkpointMemory = allocation_totals();
+            Checkpoint ckpt;
+            ckpt.step = step;
+            ckpt.time = static_cast<double>(time);
+            ckpt.addVector(state);
+            if (keepPrevious) ckpt.addVector(prevState);
+            outputs(ckpt);
+            manager.write(ckpt);
+            checkpointSecs = seconds(checkpointStart, clock_t::now());
+            timers.add("checkpoint", checkpointSecs);
+            memory.excludeFromStep(checkpointMemory);
+            if (manager.stopRequested()) return;
+        }
+    }
+}
+
+#endif
@@ -2,9 +2,20 @@
 #ifndef PDAS_EXPERIMENTS_DECOMP_HPP_
 #define PDAS_EXPERIMENTS_DECOMP_HPP_
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include "pda-schwarz/schwarz.hpp"
+#include "barriers.hpp"
+#include "checkpoint.hpp"
+#include "memory.hpp"
 #include "observer.hpp"
+#include "perf_counters.hpp"
+#include "progress.hpp"
+#include "solver_telemetry.hpp"
+#include "subiterations.hpp"
+#include "timers.hpp"
+#include "trace.hpp"
 
 template<class AppType, class ParserType>
 void run_decomp(ParserType & parser)
@@ -30,13 +41,23 @@ void run_decomp(ParserType & parser)
     namespace pdas = pdaschwarz;
     namespace pode = pressio::ode;
 
+    ScopedTimer setupTimer("setup");
+
     // tiling and meshes
+    ScopedTimer meshTimer("meshes");
+    MemoryScope meshMemory("meshes");
     auto tiling = std::make_shared<pdas::Tiling>(parser.meshDirFull());
     auto [meshObjsFull, meshPathsFull] = pdas::create_meshes(parser.meshDirFull(), tiling->count());
+    meshMemory.stop();
+    meshTimer.stop();
+
+    CheckpointManager checkpoints(parser.checkpointConfig());
 
     auto schemeVec = parser.schemeVec();
     auto fluxOrderVec = parser.fluxOrderVec();
     auto domTypeVec = parser.domTypeVec();
+    ScopedTimer subdomainTimer("subdomains");
+    MemoryScope subdomainMemory("subdomains");
     auto subdomains = pdas::create_subdomains<AppType>(
         meshObjsFull, *tiling,
         parser.probId(),
@@ -56,96 +77,424 @@ void run_decomp(ParserType & parser)
     );
     auto dtVec = parser.dtVec();
     pdas::SchwarzDecomp decomp(subdomains, tiling, dtVec);
+    subdomainMemory.stop();
+    subdomainTimer.stop();
+    const int ndomains = (*decomp.m_tiling).count();
+
+    // A checkpoint holds every subdomain's full state, then the reduced states of the ROM subdomains,
+    // and with BDF2 the same again one step earlier. On restart the subdomain steppers get their
+    // stored previous states by replaying the startup controller step from those, as
+    // advance_n_steps_checkpointed does for mono runs, so the resumed trajectory is bitwise identical.
+    std::vector<int> reducedSlot(ndomains, -1);
+    int numStateSlots = ndomains;
+    for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+        if (domTypeVec[domIdx] != "FOM") reducedSlot[domIdx] = numStateSlots++;
+    }
+    const bool keepPrevious = checkpoints.enabled()
+        && (std::find(schemeVec.begin(), schemeVec.end(), pode::StepScheme::BDF2) != schemeVec.end());
+    auto visit_states = [&](auto && fn) {
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            fn(*decomp.m_subdomainVec[domIdx]->getStateFull());
+        }
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            if (reducedSlot[domIdx] >= 0) fn(*decomp.m_subdomainVec[domIdx]->getStateReduced());
+        }
+    };
+    // the states after the last two steps, by step parity
+    std::vector<Eigen::VectorXd> previousStates[2];
+    auto keep_states = [&](int domIdx, int step) {
+        auto & kept = previousStates[step % 2];
+        kept[domIdx] = *decomp.m_subdomainVec[domIdx]->getStateFull();
+        if (reducedSlot[domIdx] >= 0) kept[reducedSlot[domIdx]] = *decomp.m_subdomainVec[domIdx]->getStateReduced();
+    };
+    const auto relTol      = parser.relTol();
+    const auto absTol      = parser.absTol();
+    const auto convStepMax = parser.convStepMax();
+    // compute contoller step until convergence
+    auto controller_step = [&](int step, double timeIn) {
+        if (parser.schwarzMode() == pdas::SchwarzMode::Multiplicative) {
+            return decomp.calc_controller_step(parser.schwarzMode(), step, timeIn, relTol, absTol, convStepMax);
+        }
+        return decomp.additive_step(step, timeIn, relTol, absTol, convStepMax);
+    };
+
+    if (checkpoints.restarting()) {
+        ScopedTimer restartTimer("restart");
+        const auto & ckpt = checkpoints.restart();
+        const bool hasPrevious = ckpt.vectors.size() == 2 * static_cast<std::size_t>(numStateSlots);
+        if (!hasPrevious && (ckpt.vectors.size() != static_cast<std::size_t>(numStateSlots))) {
+            throw std::runtime_error("Checkpoint holds " + std::to_string(ckpt.vectors.size())
+                + " state vectors, expected " + std::to_string(numStateSlots)
+                + " (full subdomain states, then reduced ROM states) or twice that with BDF2");
+        }
+        const bool anyBDF2 = std::find(schemeVec.begin(), schemeVec.end(), pode::StepScheme::BDF2) != schemeVec.end();
+        if (anyBDF2 && !hasPrevious) {
+            throw std::runtime_error("Checkpoint has no previous subdomain states, a BDF2 run cannot restart from it");
+        }
+        auto restore_states = [&](std::size_t first) {
+            visit_states([&](auto & state) { ckpt.copyVector(first++, state); });
+        };
+        if (anyBDF2) {
+            restore_states(numStateSlots);
+            PerfPause replayCounters;
+            controller_step(1, ckpt.time - decomp.m_dtMax);
+        }
+        restore_states(0);
+    }
+    if (keepPrevious) {
+        for (auto & kept : previousStates) kept.resize(numStateSlots);
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            keep_states(domIdx, static_cast<int>(checkpoints.startStep()));
+        }
+    }
+
+    ScopedTimer observerTimer("observers");
+    MemoryScope observerMemory("observers");
+
+    // observer, one file per subdomain or a single container for all of them
+    // all subdomains share a single background writer if requested
+    const int numSteps = parser.finalTime() / decomp.m_dtMax;
+    auto snapConfig = parser.snapshotConfig();
+    snapConfig.expectedRecords = expected_snapshot_count(numSteps, parser.stateSamplingFreq());
+    if (checkpoints.restarting()) {
+        truncate_output_files(checkpoints.restart());
+        snapConfig.append = true;
+    }
+    auto snapWriter = create_async_writer(snapConfig);
+    std::vector<int> nvarsVec(ndomains);
+    for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+        nvarsVec[domIdx] = (domTypeVec[domIdx] == "FOM") ? parser.numDofPerCell() : 1;
+    }
 
-    // observer
-    std::vector<StateObserver> obsVec((*decomp.m_tiling).count());
-    for (int domIdx = 0; domIdx < (*decomp.m_tiling).count(); ++domIdx) {
-        obsVec[domIdx] = StateObserver("state_snapshots_" + std::to_string(domIdx) + ".bin", parser.stateSamplingFreq());
+    std::vector<StateObserver> obsVec;
+    DecompStateObserver obsContainer;
+    // records are only batched in files holding nothing but reduced states
+    if (snapConfig.container) {
+        const bool anyFull = std::find(domTypeVec.begin(), domTypeVec.end(), "FOM") != domTypeVec.end();
+        obsContainer = DecompStateObserver("state_snapshots.bin", parser.stateSamplingFreq(),
+            anyFull ? full_state_config(snapConfig) : snapConfig, nvarsVec, decomp.m_dtMax, snapWriter);
+    }
+    else {
+        obsVec.resize(ndomains);
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            obsVec[domIdx] = StateObserver("state_snapshots_" + std::to_string(domIdx) + ".bin",
+                parser.stateSamplingFreq(),
+                (domTypeVec[domIdx] == "FOM") ? full_state_config(snapConfig) : snapConfig,
+                nvarsVec[domIdx], decomp.m_dtMax, snapWriter);
+        }
+    }
+
+    // touches only the observer of domIdx, so subdomains may be observed concurrently in per-domain mode
+    auto observe_domain = [&](int domIdx, const pode::StepCount & stepWrap, double timeIn) {
+        auto observe_one = [&](const auto & state) {
+            if (snapConfig.container) obsContainer.setBlock(domIdx, state);
+            else obsVec[domIdx](stepWrap, timeIn, state);
+        };
         if (domTypeVec[domIdx] == "FOM") {
-            obsVec[domIdx](::pressio::ode::StepCount(0), 0.0, *decomp.m_subdomainVec[domIdx]->getStateFull());
+            observe_one(*decomp.m_subdomainVec[domIdx]->getStateFull());
         }
         else {
-            obsVec[domIdx](::pressio::ode::StepCount(0), 0.0, *decomp.m_subdomainVec[domIdx]->getStateReduced());
+            observe_one(*decomp.m_subdomainVec[domIdx]->getStateReduced());
+        }
+    };
+    auto observe_states = [&](const pode::StepCount & stepWrap, double timeIn) {
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            observe_domain(domIdx, stepWrap, timeIn);
+        }
+        if (snapConfig.container) obsContainer(stepWrap, timeIn);
+    };
+    if (!checkpoints.restarting()) observe_states(pode::StepCount(0), 0.0);
+
+    // the explicit barriers of the time loop, by index; a step ends with the one after the controller.
+    // Each thread's waits per step always go to runtime.bin, the report only with barrierFile set
+    BarrierProfiler barriers(parser.barrierFile(), {"stepStart", "checkpoint", "controller"},
+        numSteps - static_cast<int>(checkpoints.startStep()), true);
+    auto runtimeColumns = RuntimeObserver::defaultColumns();
+    const std::size_t domainColumn = runtimeColumns.size();
+    for (int domIdx = 0; domIdx < ndomains; ++domIdx) runtimeColumns.push_back("domain" + std::to_string(domIdx));
+    const std::size_t waitColumn = runtimeColumns.size();
+    for (int threadIdx = 0; threadIdx < barriers.maxThreads(); ++threadIdx) runtimeColumns.push_back("wait" + std::to_string(threadIdx));
+    RuntimeObserver obs_time("runtime.bin", checkpoints.restarting(), runtimeColumns);
+
+    // error against a reference trajectory, compared on the full subdomain states
+    DecompErrorObserver obsError(parser.errorConfig(), ndomains, parser.numDofPerCell(), checkpoints.restartOrNull());
+    auto observe_errors = [&](const pode::StepCount & stepWrap, double timeIn) {
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            obsError(domIdx, stepWrap, timeIn, *decomp.m_subdomainVec[domIdx]->getStateFull());
+        }
+    };
+    if (obsError.samples(0) && !checkpoints.restarting()) observe_errors(pode::StepCount(0), 0.0);
+
+    // probed cells, ROM subdomains keep only the probed rows of their basis
+    ProbeObserver obsProbe(parser.probeConfig(), parser.numDofPerCell(), meshPathsFull, checkpoints.restartOrNull());
+    if (parser.probeConfig().enabled) {
+        const auto modeCountVec = parser.romModeCountVec();
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            if (domTypeVec[domIdx] == "FOM") continue;
+            const auto domStr = "_" + std::to_string(domIdx) + ".bin";
+            obsProbe.setReducedBasis(domIdx,
+                pdas::read_matrix_from_binary<double>(parser.romBasisRoot() + domStr, modeCountVec[domIdx]),
+                pdas::read_vector_from_binary<double>(parser.romTransRoot() + domStr));
         }
     }
-    RuntimeObserver obs_time("runtime.bin");
+    auto observe_probes = [&](const pode::StepCount & stepWrap, double timeIn) {
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            if (domTypeVec[domIdx] == "FOM") obsProbe.setState(domIdx, *decomp.m_subdomainVec[domIdx]->getStateFull());
+            else obsProbe.setState(domIdx, *decomp.m_subdomainVec[domIdx]->getStateReduced());
+        }
+        obsProbe.commit(stepWrap, timeIn);
+    };
+    if (obsProbe.samples(0) && !checkpoints.restarting()) observe_probes(pode::StepCount(0), 0.0);
 
-    // solve
-    const int numSteps     = parser.finalTime() / decomp.m_dtMax;
-    const auto relTol      = parser.relTol();
-    const auto absTol      = parser.absTol();
-    const auto convStepMax = parser.convStepMax();
+    // latest states in shared memory for monitoring, ROM subdomains publish their reduced states
+    LiveStateObserver obsLive(parser.liveConfig(), ndomains);
+    auto observe_live = [&](const pode::StepCount & stepWrap, double timeIn) {
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            if (domTypeVec[domIdx] == "FOM") obsLive.setBlock(domIdx, *decomp.m_subdomainVec[domIdx]->getStateFull());
+            else obsLive.setBlock(domIdx, *decomp.m_subdomainVec[domIdx]->getStateReduced());
+        }
+        obsLive.commit(stepWrap, timeIn);
+    };
+    if (obsLive.samples(0) && !checkpoints.restarting()) observe_live(pode::StepCount(0), 0.0);
+
+    // Schwarz subiterations per outer step, buffered for up to 1024 steps
+    SubiterationRecorder obsSubiters(parser.subiterationFile(), ndomains, relTol, absTol,
+        convStepMax, std::min(numSteps - static_cast<int>(checkpoints.startStep()), 1024),
+        checkpoints.restarting());
+
+    // subdomain solvers are built inside pda-schwarz, the telemetry holds what the controller sees of them
+    SolverStepStats subdomainStats;
+    SolverTelemetryObserver obsSolver(parser.solverTelemetryFile(), subdomainStats, checkpoints.restarting());
+    const double notSeen = std::numeric_limits<double>::quiet_NaN();
+    subdomainStats.rhsNormFirst = subdomainStats.rhsNormLast = subdomainStats.correctionNormLast = notSeen;
+    subdomainStats.linearSeconds = subdomainStats.residualSeconds = subdomainStats.jacobianSeconds = notSeen;
+
+    // outputs a restart appends to, flushed so their sizes are on disk
+    auto checkpoint_outputs = [&](Checkpoint & ckpt) {
+        auto & files = ckpt.files;
+        if (snapConfig.container) {
+            obsContainer.flush();
+            files.emplace_back(obsContainer.file().fileName(), obsContainer.file().size());
+        }
+        else {
+            for (auto & obs : obsVec) {
+                obs.flush();
+                files.emplace_back(obs.file().fileName(), obs.file().size());
+            }
+        }
+        obs_time.flush();
+        files.emplace_back(obs_time.fileName(), obs_time.size());
+        if (obsSubiters.enabled()) {
+            obsSubiters.flush();
+            files.emplace_back(obsSubiters.fileName(), obsSubiters.size());
+        }
+        if (obsSolver.enabled()) {
+            obsSolver.flush();
+            files.emplace_back(obsSolver.fileName(), obsSolver.size());
+        }
+        obsError.addOutputs(ckpt);
+        obsProbe.addOutputs(ckpt);
+    };
 
+    observerMemory.stop();
+    observerTimer.stop();
+    setupTimer.stop();
+
+    // solve
     int numSubiters;
-    double secsElapsed;
+    // wall-clock seconds of the current step's phases, kept by the master thread
+    double solveSecs = 0.0;
+    double checkpointSecs = 0.0;
+    const int startStep = static_cast<int>(checkpoints.startStep());
+    int checkpointStep = -1;
+    bool stopRun = false;
+    auto & memory = MemoryRegistry::instance();
+    memory.startSteps();
+    ProgressReporter progress(parser.progressConfig(), startStep, numSteps, true);
+
+    // A step's runtime record is written by the master thread one step later, or before a checkpoint or
+    // after the loop, once the post-step work of every subdomain is done and the waits are published.
+    // Post-step seconds are kept by step parity, each subdomain's by the thread owning it
+    std::vector<double> domainSecs[2] = {std::vector<double>(ndomains, 0.0), std::vector<double>(ndomains, 0.0)};
+    std::vector<double> runtimeRecord(runtimeColumns.size(), 0.0);
+    int runtimeStep = -1;
+    int runtimeSubiters = 0;
+    bool runtimeDomainWork = false;
+    auto write_runtime = [&]() {
+        if (runtimeStep < 0) return;
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            runtimeRecord[domainColumn + domIdx] = runtimeDomainWork ? domainSecs[runtimeStep % 2][domIdx] : 0.0;
+        }
+        for (int threadIdx = 0; threadIdx < barriers.maxThreads(); ++threadIdx) {
+            runtimeRecord[waitColumn + threadIdx] = barriers.stepWait(threadIdx, runtimeStep);
+        }
+        obs_time(runtimeStep, runtimeSubiters, RuntimeObserver::notApplicable, runtimeRecord);
+        runtimeStep = -1;
+    };
 
 #if defined SCHWARZ_ENABLE_OMP
-#pragma omp parallel firstprivate(numSteps, relTol, absTol, convStepMax)
+#pragma omp parallel firstprivate(numSteps, startStep)
 #endif
 {
 
-    double time = 0.0;
-    for (int outerStep = 1; outerStep <= numSteps; ++outerStep)
+    // every thread times its own share of the loop
+    ScopedTimer loopTimer("timeLoop");
+    auto & timers = TimerRegistry::instance();
+    double time = checkpoints.startTime();
+    barriers.start();
+    for (int outerStep = startStep + 1; outerStep <= numSteps; ++outerStep)
     {
+        TraceScope stepTrace("step", outerStep);
 
 #if defined SCHWARZ_ENABLE_OMP
+        {
+            TraceScope barrierTrace("barrier", outerStep);
+            BarrierWait barrierWait(barriers, 0);
 #pragma omp barrier
+        }
+#endif
+        // flags are set by the master thread before the barrier, so every thread sees the same value.
+        // A checkpoint flagged after the previous step waits for the barrier, once all of its output has landed
+        if (checkpointStep == outerStep - 1) {
+#if defined SCHWARZ_ENABLE_OMP
 #pragma omp master
 #endif
-        {
-            std::cout << "Step " << outerStep << std::endl;
+            {
+                TraceScope checkpointTrace("checkpoint", outerStep - 1);
+                PerfScope checkpointCounters("checkpoint");
+                const auto checkpointStart = std::chrono::high_resolution_clock::now();
+                const auto checkpointMemory = allocation_totals();
+                write_runtime();
+                Checkpoint ckpt;
+                ckpt.step = checkpointStep;
+                ckpt.time = time;
+                visit_states([&](const auto & state) { ckpt.addVector(state); });
+                if (keepPrevious) {
+                    for (const auto & state : previousStates[(checkpointStep - 1) % 2]) ckpt.addVector(state);
+                }
+                checkpoint_outputs(ckpt);
+                checkpoints.write(ckpt);
+                stopRun = checkpoints.stopRequested();
+                const std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - checkpointStart;
+                checkpointSecs = duration.count();
+                timers.add("checkpoint", checkpointSecs);
+                memory.excludeFromStep(checkpointMemory);
+            }
+#if defined SCHWARZ_ENABLE_OMP
+            TraceScope barrierTrace("barrier", outerStep);
+            BarrierWait barrierWait(barriers, 1);
+#pragma omp barrier
+#endif
         }
+        if (stopRun) break;
+
         // this has to be outside the omp block
         auto runtimeStart = std::chrono::high_resolution_clock::now();
+        ScopedTimer controllerTimer("controller");
+        TraceScope controllerTrace("controller", outerStep);
+        PerfScope controllerCounters("controller");
 
-        // compute contoller step until convergence
-        if (parser.schwarzMode() == pdas::SchwarzMode::Multiplicative) {
-            numSubiters = decomp.calc_controller_step(
-                parser.schwarzMode(),
-                outerStep,
-                time,
-                relTol,
-                absTol,
-                convStepMax
-            );
-        }
-        else {
-            numSubiters = decomp.additive_step(
-                outerStep,
-                time,
-                relTol,
-                absTol,
-                convStepMax
-            );
-        }
+        numSubiters = controller_step(outerStep, time);
         time += decomp.m_dtMax;
+        controllerTimer.stop();
+        controllerTrace.setSubiterations(numSubiters);
+        stepTrace.setSubiterations(numSubiters);
+        controllerTrace.stop();
+        controllerCounters.stop();
 
 #if defined SCHWARZ_ENABLE_OMP
+        {
+            TraceScope barrierTrace("barrier", outerStep);
+            BarrierWait barrierWait(barriers, 2, true, outerStep);
 #pragma omp barrier
+        }
+#pragma omp master
+#endif
+        {
+            const std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - runtimeStart;
+            solveSecs = duration.count();
+        }
+        const auto observerStart = std::chrono::high_resolution_clock::now();
+
+        // per-domain snapshot files are written by the thread owning the subdomain, with no barrier after;
+        // a container record holds every subdomain and is written by the master thread below
+        // the states a BDF2 checkpoint needs one step later are kept the same way
+        const bool sampleStates = ((outerStep % parser.stateSamplingFreq()) == 0);
+        const bool domainWork = keepPrevious || (sampleStates && !snapConfig.container);
+        if (domainWork) {
+#if defined SCHWARZ_ENABLE_OMP
+#pragma omp for schedule(static) nowait
+#endif
+            for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+                TraceScope domainTrace("subdomainPost", outerStep, domIdx);
+                const auto domainStart = std::chrono::high_resolution_clock::now();
+                if (keepPrevious) keep_states(domIdx, outerStep);
+                if (sampleStates && !snapConfig.container) {
+                    ScopedTimer snapshotTimer("snapshots");
+                    TraceScope snapshotTrace("snapshot", outerStep, domIdx);
+                    PerfScope snapshotCounters("snapshots");
+                    observe_domain(domIdx, pode::StepCount(outerStep), time);
+                }
+                const std::chrono::duration<double> domainDuration = std::chrono::high_resolution_clock::now() - domainStart;
+                domainSecs[outerStep % 2][domIdx] = domainDuration.count();
+            }
+        }
+
+#if defined SCHWARZ_ENABLE_OMP
 #pragma omp master
 #endif
         {
-            // calculate step runtime, output
-            const auto runtimeEnd = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double, std::milli> duration = runtimeEnd - runtimeStart;
-            obs_time(duration.count() * 1e-3, numSubiters);
-
-            // output observer
-            if ((outerStep % parser.stateSamplingFreq()) == 0) {
-                const auto stepWrap = pode::StepCount(outerStep);
-                for (int domIdx = 0; domIdx < (*decomp.m_tiling).count(); ++domIdx) {
-                    if (domTypeVec[domIdx] == "FOM") {
-                        obsVec[domIdx](stepWrap, time, *decomp.m_subdomainVec[domIdx]->getStateFull());
-                    }
-                    else {
-                        obsVec[domIdx](stepWrap, time, *decomp.m_subdomainVec[domIdx]->getStateReduced());
-                    }
+            TraceScope observerTrace("observers", outerStep);
+            PerfScope observerCounters("observers");
+            if (sampleStates && snapConfig.container) {
+                observe_states(pode::StepCount(outerStep), time);
+            }
+            if (obsError.samples(outerStep)) {
+                observe_errors(pode::StepCount(outerStep), time);
+            }
+            if (obsProbe.samples(outerStep)) {
+                observe_probes(pode::StepCount(outerStep), time);
+            }
+            if (obsLive.samples(outerStep)) {
+                observe_live(pode::StepCount(outerStep), time);
+            }
+
+            // observer time as seen by the master thread, its share of the per-domain files included
+            const std::chrono::duration<double> observerDuration = std::chrono::high_resolution_clock::now() - observerStart;
+            timers.add("observers", observerDuration.count());
+            obsSubiters.commit(outerStep, numSubiters);
+            if (obsSolver.enabled()) {
+                subdomainStats.nonlinearIters = static_cast<std::uint32_t>(numSubiters);
+                subdomainStats.stepSeconds = solveSecs;
+                for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+                    obsSolver.write(outerStep, static_cast<std::uint32_t>(domIdx), subdomainStats);
                 }
             }
+            progress(outerStep, time, numSubiters);
+            barriers.commit(outerStep);
+            write_runtime();
+            runtimeStep = outerStep;
+            runtimeSubiters = numSubiters;
+            runtimeDomainWork = domainWork;
+            runtimeRecord[0] = solveSecs;
+            runtimeRecord[1] = observerDuration.count();
+            runtimeRecord[2] = checkpointSecs;
+            memory.recordStep(outerStep);
+            checkpointSecs = 0.0;
+
+            if (checkpoints.due()) checkpointStep = outerStep;
         }
 
     }
 } // end parallel block
+    write_runtime();
+    progress.finish();
+    barriers.finish();
+    barriers.write();
+
+    ScopedTimer finalizeTimer("finalize");
+    obsError.finalize();
+    obsSubiters.finalize();
 }
 
 #endif
\ No newline at end of file
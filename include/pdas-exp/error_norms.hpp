@@ -0,0 +1,237 @@
+#ifndef PDAS_EXPERIMENTS_ERROR_NORMS_HPP_
+#define PDAS_EXPERIMENTS_ERROR_NORMS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot_io.hpp"
+
+// In-situ error norms against a reference (FOM) trajectory
+struct ErrorConfig
+{
+    bool enabled = false;
+    std::string reference = "";     // snapshot file, or file root for decomposed references
+    int sampleFreq = 1;             // steps between error evaluations
+    int referenceSampleFreq = 1;    // raw reference files only, indexed files record their own
+};
+
+/*
+    Reference snapshots looked up by step number, mapped read-only.
+    Indexed files may be compressed or single precision; raw files are headerless doubles
+    written every referenceSampleFreq steps.
+*/
+class ReferenceTrajectory
+{
+public:
+    ReferenceTrajectory(const std::string & f0, int rawSampleFreq)
+        : fileName_(f0), rawSampleFreq_(rawSampleFreq)
+    {
+        char magic[8] = {};
+        std::ifstream fin(f0, std::ios::in | std::ios::binary);
+        if (!fin) throw std::runtime_error("ReferenceTrajectory: could not open " + f0);
+        fin.read(magic, sizeof(magic));
+        fin.close();
+
+        if (std::memcmp(magic, snapfmt::headerMagic, 8) == 0) {
+            reader_ = std::make_unique<SnapshotReader>(f0);
+        }
+        else {
+            map_raw();
+        }
+    }
+
+    ReferenceTrajectory(const ReferenceTrajectory &) = delete;
+    ReferenceTrajectory & operator=(const ReferenceTrajectory &) = delete;
+
+    ~ReferenceTrajectory()
+    {
+        if (base_) ::munmap(const_cast<char *>(base_), size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    std::size_t numBlocks() const { return reader_ ? reader_->numBlocks() : 1; }
+
+    // reference block at the given step, nullptr if that step was not stored
+    const double * find(std::int64_t step, std::size_t length, std::size_t block = 0)
+    {
+        if (!reader_) {
+            if ((rawSampleFreq_ <= 0) || (step % rawSampleFreq_ != 0)) return nullptr;
+            const std::size_t offset = static_cast<std::size_t>(step / rawSampleFreq_) * length * sizeof(double);
+            if (offset + length * sizeof(double) > size_) return nullptr;
+            return reinterpret_cast<const double *>(base_ + offset);
+        }
+
+        if (reader_->vectorLength(block) != length) {
+            throw std::runtime_error("ReferenceTrajectory: " + fileName_ + " block " + std::to_string(block)
+                + " has length " + std::to_string(reader_->vectorLength(block)) + ", expected " + std::to_string(length));
+        }
+        const long k = reader_->findStep(step);
+        if (k < 0) return nullptr;
+
+        // zero-copy unless the file has to be decoded, reordered or widened
+        if ((reader_->codec() == SnapshotCodecType::None) && (reader_->scalarSize() == sizeof(double))
+            && (reader_->layout() == SnapshotLayout::CellInterleaved)) {
+            return reader_->snapshot<double>(k, block);
+        }
+        buffer_.resize(length);
+        if (reader_->scalarSize() == sizeof(double)) {
+            reader_->read(k, buffer_.data(), block);
+        }
+        else {
+            narrow_.resize(length);
+            reader_->read(k, narrow_.data(), block);
+            for (std::size_t i = 0; i < length; ++i) buffer_[i] = narrow_[i];
+        }
+        return buffer_.data();
+    }
+
+private:
+    void map_raw()
+    {
+        // the destructor does not run if this throws
+        const int fd = ::open(fileName_.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("ReferenceTrajectory: could not open " + fileName_);
+        struct stat st;
+        void * addr = MAP_FAILED;
+        if ((::fstat(fd, &st) == 0) && (st.st_size > 0)) {
+            addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("ReferenceTrajectory: could not map " + fileName_);
+        }
+        fd_ = fd;
+        size_ = static_cast<std::size_t>(st.st_size);
+        base_ = static_cast<const char *>(addr);
+    }
+
+    std::string fileName_;
+    int rawSampleFreq_ = 1;
+    std::unique_ptr<SnapshotReader> reader_;
+    int fd_ = -1;
+    std::size_t size_ = 0;
+    const char * base_ = nullptr;
+    std::vector<double> buffer_;
+    std::vector<float> narrow_;
+};
+
+/*
+    Per-variable spatial L2 errors of cell-interleaved states, one record per evaluation:
+    header: std::uint64_t nvars
+    record: std::int64_t step, double time, double absolute error x nvars, double relative error x nvars
+    Space-time norms over all records are reported by finalize(). A restarted run appends to the
+    file and continues from the running sums() saved with the checkpoint.
+*/
+class ErrorHistory
+{
+public:
+    // restartSums: sums() when the checkpoint was taken, the file is then appended to
+    ErrorHistory(const std::string & f0, int nvars, const std::vector<double> * restartSums = nullptr)
+        : fileName_(f0),
+        file_(f0, std::ios::out | std::ios::binary | (restartSums ? std::ios::app : std::ios::trunc)),
+        nvars_(nvars), errSq_(nvars), refSq_(nvars), sumErrSq_(nvars, 0.0), sumRefSq_(nvars, 0.0),
+        record_(2 * nvars)
+    {
+        if (!file_) throw std::runtime_error("Could not open " + f0);
+        if (restartSums) {
+            if (restartSums->size() != static_cast<std::size_t>(2 * nvars_ + 1)) {
+                throw std::runtime_error("ErrorHistory: checkpointed sums of " + f0 + " do not match " + std::to_string(nvars_) + " variables");
+            }
+            std::copy(restartSums->begin(), restartSums->begin() + nvars_, sumErrSq_.begin());
+            std::copy(restartSums->begin() + nvars_, restartSums->begin() + 2 * nvars_, sumRefSq_.begin());
+            numRecords_ = static_cast<std::size_t>(restartSums->back());
+            std::ifstream fin(f0, std::ios::in | std::ios::binary | std::ios::ate);
+            size_ = static_cast<std::uint64_t>(fin.tellg());
+            return;
+        }
+        const std::uint64_t nvars_u64 = nvars_;
+        file_.write(reinterpret_cast<const char*>(&nvars_u64), sizeof(std::uint64_t));
+        size_ = sizeof(std::uint64_t);
+    }
+
+    ~ErrorHistory() { file_.close(); }
+
+    void add(std::int64_t step, double time, const double * state, const double * reference, std::size_t length)
+    {
+        if (length % nvars_ != 0) {
+            throw std::runtime_error("ErrorHistory: state length is not a multiple of " + std::to_string(nvars_));
+        }
+        std::fill(errSq_.begin(), errSq_.end(), 0.0);
+        std::fill(refSq_.begin(), refSq_.end(), 0.0);
+        for (std::size_t i = 0; i < length; i += nvars_) {
+            for (int var = 0; var < nvars_; ++var) {
+                const double diff = state[i + var] - reference[i + var];
+                errSq_[var] += diff * diff;
+                refSq_[var] += reference[i + var] * reference[i + var];
+            }
+        }
+
+        for (int var = 0; var < nvars_; ++var) {
+            sumErrSq_[var] += errSq_[var];
+            sumRefSq_[var] += refSq_[var];
+            record_[var] = std::sqrt(errSq_[var]);
+            record_[nvars_ + var] = (refSq_[var] > 0.0) ? std::sqrt(errSq_[var] / refSq_[var]) : 0.0;
+        }
+        file_.write(reinterpret_cast<const char*>(&step), sizeof(std::int64_t));
+        file_.write(reinterpret_cast<const char*>(&time), sizeof(double));
+        file_.write(reinterpret_cast<const char*>(record_.data()), record_.size() * sizeof(double));
+        size_ += sizeof(std::int64_t) + sizeof(double) + record_.size() * sizeof(double);
+        ++numRecords_;
+    }
+
+    // squared error and reference norms summed per variable, then the number of records
+    std::vector<double> sums() const
+    {
+        std::vector<double> out(sumErrSq_);
+        out.insert(out.end(), sumRefSq_.begin(), sumRefSq_.end());
+        out.push_back(static_cast<double>(numRecords_));
+        return out;
+    }
+
+    void flush() { file_.flush(); }
+
+    const std::string & fileName() const { return fileName_; }
+
+    std::uint64_t size() const { return size_; }
+
+    void finalize()
+    {
+        file_.flush();
+        if (numRecords_ == 0) {
+            std::cout << fileName_ << ": no steps matched the reference trajectory" << std::endl;
+            return;
+        }
+        std::cout << fileName_ << ": space-time relative error per variable over " << numRecords_ << " steps:";
+        for (int var = 0; var < nvars_; ++var) {
+            std::cout << " " << ((sumRefSq_[var] > 0.0) ? std::sqrt(sumErrSq_[var] / sumRefSq_[var]) : 0.0);
+        }
+        std::cout << std::endl;
+    }
+
+private:
+    std::string fileName_;
+    std::ofstream file_;
+    int nvars_ = 1;
+    std::vector<double> errSq_;
+    std::vector<double> refSq_;
+    std::vector<double> sumErrSq_;
+    std::vector<double> sumRefSq_;
+    std::vector<double> record_;
+    std::size_t numRecords_ = 0;
+    std::uint64_t size_ = 0;
+};
+
+#endif
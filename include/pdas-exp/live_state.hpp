@@ -0,0 +1,270 @@
+#ifndef PDAS_EXPERIMENTS_LIVE_STATE_HPP_
+#define PDAS_EXPERIMENTS_LIVE_STATE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Live state publishing, the "live" block of the input file
+struct LiveConfig
+{
+    bool enabled = false;
+    std::string name = "/pdas_live";    // POSIX shared memory object, shows up as /dev/shm/pdas_live
+    int sampleFreq = 1;
+    int slots = 4;                      // most recent samples kept
+};
+
+/*
+    Shared memory ring buffer of the latest sampled states
+
+    [Header][std::uint64_t length x numBlocks][Slot x numSlots]
+    Slot: [std::uint64_t seq][std::int64_t step][double time][double x sum(lengths)]
+
+    Sample n (counting from 1) goes to slot (n - 1) % numSlots. Its seq is 2n - 1 while the
+    slot is being written and 2n once complete, after which the header's count becomes n.
+    Readers copy a slot and accept it if seq was the same even value before and after the
+    copy (a seqlock), so the publisher never waits on them.
+*/
+
+namespace livefmt {
+
+constexpr char magic[8] = {'P', 'D', 'A', 'S', 'L', 'I', 'V', 'E'};
+constexpr std::uint32_t version = 1;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t numSlots;
+    std::uint64_t numBlocks;
+    std::uint64_t slotBytes;    // whole slot, seq/step/time included
+    std::uint64_t count;        // samples published, accessed atomically
+    std::uint64_t reserved[3];
+};
+
+struct SlotHeader
+{
+    std::uint64_t seq;          // accessed atomically
+    std::int64_t step;
+    double time;
+};
+
+static_assert(sizeof(Header) == 64, "unexpected live Header padding");
+static_assert(sizeof(SlotHeader) == 24, "unexpected live SlotHeader padding");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory counters need lock-free 64-bit atomics");
+
+inline std::atomic<std::uint64_t> & atomic_at(char * addr)
+{
+    return *reinterpret_cast<std::atomic<std::uint64_t> *>(addr);
+}
+
+inline std::size_t slots_offset(std::size_t numBlocks)
+{
+    // keeps every slot 8-byte aligned
+    return sizeof(Header) + numBlocks * sizeof(std::uint64_t);
+}
+
+} // namespace livefmt
+
+// Writer side, owned by the solver. The segment is sized on the first publish and removed on destruction.
+class LiveStatePublisher
+{
+public:
+    LiveStatePublisher() = default;
+
+    LiveStatePublisher(const std::string & name, int numSlots)
+        : name_(name), numSlots_(numSlots > 0 ? numSlots : 1){}
+
+    LiveStatePublisher(const LiveStatePublisher &) = delete;
+    LiveStatePublisher & operator=(const LiveStatePublisher &) = delete;
+
+    LiveStatePublisher(LiveStatePublisher && other) noexcept { *this = std::move(other); }
+    LiveStatePublisher & operator=(LiveStatePublisher && other) noexcept
+    {
+        std::swap(name_, other.name_);
+        std::swap(numSlots_, other.numSlots_);
+        std::swap(base_, other.base_);
+        std::swap(size_, other.size_);
+        std::swap(lengths_, other.lengths_);
+        std::swap(count_, other.count_);
+        return *this;
+    }
+
+    ~LiveStatePublisher()
+    {
+        if (base_ == nullptr) return;
+        ::munmap(base_, size_);
+        // attached readers keep their mapping
+        ::shm_unlink(name_.c_str());
+    }
+
+    void publish(std::int64_t step, double time, const std::vector<std::pair<const double *, std::size_t>> & blocks)
+    {
+        if (base_ == nullptr) create(blocks);
+        if (blocks.size() != lengths_.size()) {
+            throw std::runtime_error("LiveStatePublisher: block count changed between samples");
+        }
+
+        const std::uint64_t n = ++count_;
+        char * slot = slot_at((n - 1) % numSlots_);
+        auto & seq = livefmt::atomic_at(slot);
+        seq.store(2 * n - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(slot + offsetof(livefmt::SlotHeader, step), &step, sizeof(step));
+        std::memcpy(slot + offsetof(livefmt::SlotHeader, time), &time, sizeof(time));
+        char * data = slot + sizeof(livefmt::SlotHeader);
+        for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+            if (blocks[blockIdx].second != lengths_[blockIdx]) {
+                throw std::runtime_error("LiveStatePublisher: vector length changed between samples");
+            }
+            std::memcpy(data, blocks[blockIdx].first, lengths_[blockIdx] * sizeof(double));
+            data += lengths_[blockIdx] * sizeof(double);
+        }
+
+        seq.store(2 * n, std::memory_order_release);
+        livefmt::atomic_at(base_ + offsetof(livefmt::Header, count)).store(n, std::memory_order_release);
+    }
+
+private:
+    void create(const std::vector<std::pair<const double *, std::size_t>> & blocks)
+    {
+        std::uint64_t slotBytes = sizeof(livefmt::SlotHeader);
+        for (const auto & block : blocks) {
+            lengths_.push_back(block.second);
+            slotBytes += block.second * sizeof(double);
+        }
+        size_ = livefmt::slots_offset(blocks.size()) + numSlots_ * slotBytes;
+
+        // replaces a segment left behind by an earlier run
+        ::shm_unlink(name_.c_str());
+        const int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) throw std::runtime_error("LiveStatePublisher: could not create shared memory " + name_);
+        void * addr = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(size_)) == 0) {
+            addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            ::shm_unlink(name_.c_str());
+            throw std::runtime_error("LiveStatePublisher: could not map shared memory " + name_);
+        }
+        base_ = static_cast<char *>(addr);
+
+        // zero-filled by ftruncate; count stays 0 until the first sample is complete
+        livefmt::Header header = {{}, livefmt::version, static_cast<std::uint32_t>(numSlots_),
+            blocks.size(), slotBytes, 0, {}};
+        std::memcpy(header.magic, livefmt::magic, 8);
+        std::memcpy(base_, &header, sizeof(header));
+        std::memcpy(base_ + sizeof(header), lengths_.data(), lengths_.size() * sizeof(std::uint64_t));
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    char * slot_at(std::size_t slotIdx) const
+    {
+        const auto slotBytes = reinterpret_cast<const livefmt::Header *>(base_)->slotBytes;
+        return base_ + livefmt::slots_offset(lengths_.size()) + slotIdx * slotBytes;
+    }
+
+    std::string name_;
+    std::size_t numSlots_ = 1;
+    char * base_ = nullptr;
+    std::size_t size_ = 0;
+    std::vector<std::uint64_t> lengths_;
+    std::uint64_t count_ = 0;
+};
+
+// Reader side, for monitoring processes; never blocks the publisher
+class LiveStateReader
+{
+public:
+    explicit LiveStateReader(const std::string & name)
+        : name_(name)
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) throw std::runtime_error("LiveStateReader: no shared memory " + name);
+        struct stat st;
+        void * addr = MAP_FAILED;
+        if ((::fstat(fd, &st) == 0) && (static_cast<std::size_t>(st.st_size) >= sizeof(livefmt::Header))) {
+            size_ = static_cast<std::size_t>(st.st_size);
+            addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (addr == MAP_FAILED) throw std::runtime_error("LiveStateReader: could not map " + name + ", not published yet?");
+        base_ = static_cast<char *>(addr);
+
+        std::memcpy(&header_, base_, sizeof(header_));
+        if ((std::memcmp(header_.magic, livefmt::magic, 8) != 0) || (header_.version > livefmt::version)) {
+            ::munmap(base_, size_);
+            throw std::runtime_error("LiveStateReader: " + name + " is not a live state segment");
+        }
+        lengths_.resize(header_.numBlocks);
+        std::memcpy(lengths_.data(), base_ + sizeof(header_), lengths_.size() * sizeof(std::uint64_t));
+    }
+
+    LiveStateReader(const LiveStateReader &) = delete;
+    LiveStateReader & operator=(const LiveStateReader &) = delete;
+
+    ~LiveStateReader() { ::munmap(base_, size_); }
+
+    std::size_t numBlocks()                       const { return lengths_.size(); }
+    std::size_t numSlots()                        const { return header_.numSlots; }
+    std::size_t vectorLength(std::size_t b = 0)   const { return lengths_.at(b); }
+
+    // samples published so far
+    std::uint64_t count() const
+    {
+        return livefmt::atomic_at(base_ + offsetof(livefmt::Header, count)).load(std::memory_order_acquire);
+    }
+
+    // copy of sample n (1-based) into blocks; false if it has been overwritten or was never published
+    bool read(std::uint64_t n, std::int64_t & step, double & time, std::vector<std::vector<double>> & blocks) const
+    {
+        if ((n == 0) || (n > count())) return false;
+        const char * slot = base_ + livefmt::slots_offset(lengths_.size()) + ((n - 1) % header_.numSlots) * header_.slotBytes;
+        auto & seq = livefmt::atomic_at(const_cast<char *>(slot));
+
+        if (seq.load(std::memory_order_acquire) != 2 * n) return false;
+        std::memcpy(&step, slot + offsetof(livefmt::SlotHeader, step), sizeof(step));
+        std::memcpy(&time, slot + offsetof(livefmt::SlotHeader, time), sizeof(time));
+        blocks.resize(lengths_.size());
+        const char * data = slot + sizeof(livefmt::SlotHeader);
+        for (std::size_t blockIdx = 0; blockIdx < lengths_.size(); ++blockIdx) {
+            blocks[blockIdx].resize(lengths_[blockIdx]);
+            std::memcpy(blocks[blockIdx].data(), data, lengths_[blockIdx] * sizeof(double));
+            data += lengths_[blockIdx] * sizeof(double);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq.load(std::memory_order_relaxed) == 2 * n;
+    }
+
+    // most recent complete sample, retrying while the publisher laps the reader; false if none yet
+    bool latest(std::int64_t & step, double & time, std::vector<std::vector<double>> & blocks) const
+    {
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            const auto n = count();
+            if (n == 0) return false;
+            if (read(n, step, time, blocks)) return true;
+        }
+        return false;
+    }
+
+private:
+    std::string name_;
+    char * base_ = nullptr;
+    std::size_t size_ = 0;
+    livefmt::Header header_ = {};
+    std::vector<std::uint64_t> lengths_;
+};
+
+#endif
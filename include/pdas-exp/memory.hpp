@@ -0,0 +1,303 @@
+#ifndef PDAS_EXPERIMENTS_MEMORY_HPP_
+#define PDAS_EXPERIMENTS_MEMORY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+    Heap allocations and resident memory per phase and outer step:
+
+        MemoryScope scope("subdomains");
+        ...
+        memory.startSteps();
+        for (...) { ...; memory.recordStep(step); }
+
+    Allocations are counted by the malloc family hooks in src/runner.cc (glibc only, COUNT_ALLOCATIONS
+    CMake option, off by default), which call memory_impl::count_allocation/count_free. They count
+    nothing until MemoryRegistry::enable(). Every thread counts into its own slot without locking;
+    a phase sees the allocations of all threads. Resident memory comes from
+    /proc/self/status, the peak being reset at the start of each phase and step through
+    /proc/self/clear_refs where the kernel allows it.
+    With memoryFile set in the input, the report is written as JSON when the runner exits:
+
+    {"version": 1, "countsAllocations": true, "peakResettable": true,
+     "phases": [{"name": "meshes", "allocBytes": 1024, "allocCount": 3, "freeCount": 1, "peakRssBytes": ..., "rssBytes": ...}, ...],
+     "steps": [{"step": 1, "allocBytes": ..., "allocCount": ..., "freeCount": ..., "peakRssBytes": ..., "rssBytes": ...}, ...],
+     "steadyStateAllocatingSteps": 0}
+
+    Steps after the first two of a run (BDF2 startup, first touch of work arrays) should not allocate,
+    checkpoints aside; the ones that do are counted in steadyStateAllocatingSteps and reported on stdout.
+    Known exceptions: with snapshotAsync the first queueDepth + 2 writes fill AsyncWriter's buffer
+    pool, and with traceFile set the steps in which a thread's trace buffer doubles allocate.
+*/
+
+namespace memory_impl {
+
+constexpr int max_slots = 256;
+
+// one writer per slot, so relaxed load + store instead of a locked add; the last slot is shared
+struct alignas(64) AllocationSlot
+{
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> frees{0};
+};
+
+inline AllocationSlot slots[max_slots];
+inline std::atomic<int> slotsUsed{0};
+inline std::atomic<bool> counting{false};     // set by MemoryRegistry::enable
+
+// no allocation in here, it runs inside malloc
+inline AllocationSlot & thread_slot(bool & shared)
+{
+    thread_local int slot = -1;
+    if (slot < 0) slot = std::min(slotsUsed.fetch_add(1, std::memory_order_relaxed), max_slots - 1);
+    shared = (slot == max_slots - 1);
+    return slots[slot];
+}
+
+inline void bump(std::atomic<std::uint64_t> & counter, std::uint64_t value, bool shared)
+{
+    if (shared) counter.fetch_add(value, std::memory_order_relaxed);
+    else counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void count_allocation(std::size_t size)
+{
+    if (!counting.load(std::memory_order_relaxed)) return;
+    bool shared;
+    auto & slot = thread_slot(shared);
+    bump(slot.bytes, size, shared);
+    bump(slot.count, 1, shared);
+}
+
+inline void count_free()
+{
+    if (!counting.load(std::memory_order_relaxed)) return;
+    bool shared;
+    auto & slot = thread_slot(shared);
+    bump(slot.frees, 1, shared);
+}
+
+} // namespace memory_impl
+
+struct MemorySample
+{
+    std::uint64_t allocBytes = 0;
+    std::uint64_t allocCount = 0;
+    std::uint64_t freeCount = 0;
+    std::uint64_t peakRssBytes = 0;
+    std::uint64_t rssBytes = 0;
+};
+
+// allocation totals over all threads so far
+inline MemorySample allocation_totals()
+{
+    MemorySample totals;
+    const int numSlots = std::min(memory_impl::slotsUsed.load(std::memory_order_relaxed), memory_impl::max_slots);
+    for (int slotIdx = 0; slotIdx < numSlots; ++slotIdx) {
+        const auto & slot = memory_impl::slots[slotIdx];
+        totals.allocBytes += slot.bytes.load(std::memory_order_relaxed);
+        totals.allocCount += slot.count.load(std::memory_order_relaxed);
+        totals.freeCount += slot.frees.load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+// current and peak resident set from /proc/self/status, read without allocating; false if unavailable
+inline bool read_rss(std::uint64_t & rssBytes, std::uint64_t & peakRssBytes)
+{
+    const int fd = ::open("/proc/self/status", O_RDONLY);
+    if (fd < 0) return false;
+    char buf[4096];
+    const auto len = ::read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+    if (len <= 0) return false;
+    buf[len] = '\0';
+
+    auto field_kb = [&](const char * key) -> std::uint64_t {
+        const char * pos = std::strstr(buf, key);
+        return pos ? std::strtoull(pos + std::strlen(key), nullptr, 10) : 0;
+    };
+    rssBytes = 1024 * field_kb("VmRSS:");
+    peakRssBytes = 1024 * field_kb("VmHWM:");
+    return true;
+}
+
+// restarts the peak resident set from the current one
+inline bool reset_peak_rss()
+{
+    const int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) return false;
+    const bool ok = (::write(fd, "5", 1) == 1);
+    ::close(fd);
+    return ok;
+}
+
+class MemoryRegistry
+{
+public:
+    static MemoryRegistry & instance()
+    {
+        static MemoryRegistry registry;
+        return registry;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // countsAllocations: the allocator hooks are compiled in
+    void enable(const std::string & f0, bool countsAllocations)
+    {
+        fileName_ = f0;
+        countsAllocations_ = countsAllocations;
+        enabled_ = true;
+        peakResettable_ = reset_peak_rss();
+        memory_impl::counting.store(countsAllocations_, std::memory_order_relaxed);
+        if (!countsAllocations_) {
+            std::cout << "Heap allocations are not counted in this build, memoryFile reports resident memory only" << std::endl;
+        }
+    }
+
+    // the allocation totals and restarted peak a phase or step is measured from
+    MemorySample start() const
+    {
+        if (peakResettable_) reset_peak_rss();
+        return allocation_totals();
+    }
+
+    // what happened since start; allocation totals are read before anything here allocates
+    MemorySample since(const MemorySample & start) const
+    {
+        MemorySample sample = allocation_totals();
+        sample.allocBytes -= start.allocBytes;
+        sample.allocCount -= start.allocCount;
+        sample.freeCount -= start.freeCount;
+        read_rss(sample.rssBytes, sample.peakRssBytes);
+        return sample;
+    }
+
+    void addPhase(const std::string & name, const MemorySample & sample)
+    {
+        phases_.emplace_back(name, sample);
+    }
+
+    void startSteps()
+    {
+        if (enabled_) stepStart_ = start();
+    }
+
+    // call at the end of each outer step, from one thread; the step runs from the previous call or startSteps()
+    void recordStep(std::int64_t step)
+    {
+        if (!enabled_) return;
+        const auto sample = since(stepStart_);
+        steps_.emplace_back(step, sample);
+        if ((steps_.size() > 2) && (sample.allocCount > 0)) steadyAllocating_ += 1;
+        stepStart_ = start();
+    }
+
+    // leaves the allocations since start (allocation_totals() before e.g. writing a checkpoint) out of the current step
+    void excludeFromStep(const MemorySample & start)
+    {
+        if (!enabled_) return;
+        const auto totals = allocation_totals();
+        stepStart_.allocBytes += totals.allocBytes - start.allocBytes;
+        stepStart_.allocCount += totals.allocCount - start.allocCount;
+        stepStart_.freeCount += totals.freeCount - start.freeCount;
+    }
+
+    void write() const
+    {
+        if (!enabled_) return;
+        std::ofstream fout(fileName_);
+        if (!fout) throw std::runtime_error("Could not open " + fileName_);
+
+        auto write_sample = [&](const MemorySample & sample) {
+            if (countsAllocations_) {
+                fout << ", \"allocBytes\": " << sample.allocBytes << ", \"allocCount\": " << sample.allocCount
+                    << ", \"freeCount\": " << sample.freeCount;
+            }
+            else {
+                fout << ", \"allocBytes\": null, \"allocCount\": null, \"freeCount\": null";
+            }
+            fout << ", \"peakRssBytes\": " << sample.peakRssBytes << ", \"rssBytes\": " << sample.rssBytes << "}";
+        };
+
+        fout << "{\"version\": 1, \"countsAllocations\": " << (countsAllocations_ ? "true" : "false")
+            << ", \"peakResettable\": " << (peakResettable_ ? "true" : "false") << ",\n\"phases\": [";
+        for (std::size_t phaseIdx = 0; phaseIdx < phases_.size(); ++phaseIdx) {
+            fout << (phaseIdx ? ",\n" : "\n") << "{\"name\": \"" << phases_[phaseIdx].first << "\"";
+            write_sample(phases_[phaseIdx].second);
+        }
+        fout << "],\n\"steps\": [";
+        for (std::size_t stepIdx = 0; stepIdx < steps_.size(); ++stepIdx) {
+            fout << (stepIdx ? ",\n" : "\n") << "{\"step\": " << steps_[stepIdx].first;
+            write_sample(steps_[stepIdx].second);
+        }
+        fout << "],\n\"steadyStateAllocatingSteps\": ";
+        if (countsAllocations_) fout << steadyAllocating_;
+        else fout << "null";
+        fout << "}\n";
+
+        if (countsAllocations_ && (steadyAllocating_ > 0)) {
+            std::cout << "Warning: " << steadyAllocating_ << " of " << steps_.size()
+                << " outer steps allocated on the heap after startup, see " << fileName_ << std::endl;
+        }
+    }
+
+private:
+    MemoryRegistry() = default;
+
+    bool enabled_ = false;
+    bool countsAllocations_ = false;
+    bool peakResettable_ = false;
+    std::string fileName_;
+    std::vector<std::pair<std::string, MemorySample>> phases_;
+    std::vector<std::pair<std::int64_t, MemorySample>> steps_;
+    MemorySample stepStart_;
+    std::size_t steadyAllocating_ = 0;
+};
+
+// one phase, from construction to destruction (or stop()); call from the thread running the phase
+class MemoryScope
+{
+public:
+    explicit MemoryScope(const char * name)
+    {
+        auto & registry = MemoryRegistry::instance();
+        if (!registry.enabled()) return;
+        name_ = name;
+        start_ = registry.start();
+    }
+
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope & operator=(const MemoryScope &) = delete;
+
+    ~MemoryScope() { stop(); }
+
+    void stop()
+    {
+        if (name_ == nullptr) return;
+        auto & registry = MemoryRegistry::instance();
+        registry.addPhase(name_, registry.since(start_));
+        name_ = nullptr;
+    }
+
+private:
+    const char * name_ = nullptr;
+    MemorySample start_;
+};
+
+#endif
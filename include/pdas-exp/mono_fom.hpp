@@ -3,8 +3,10 @@
 
 #include "pressio/ode_steppers_implicit.hpp"
 #include "pressio/ode_advancers.hpp"
+#include "checkpoint.hpp"
 #include "observer.hpp"
-#include <chrono>
+#include "solver_telemetry.hpp"
+#include "timers.hpp"
 
 template<class AppType, class ParserType>
 void run_mono_fom(AppType & system, ParserType & parser)
@@ -24,6 +26,8 @@ void run_mono_fom(AppType & system, ParserType & parser)
     using state_t = typename app_t::state_type;
     using jacob_t = typename app_t::jacobian_type;
 
+    ScopedTimer setupTimer("setup");
+
     // initial condition
     state_t state = system.initialCondition();
     std::string icFile = parser.icFile();
@@ -40,31 +44,66 @@ void run_mono_fom(AppType & system, ParserType & parser)
     }
 
     const auto odeScheme = parser.odeScheme();
-    auto stepperObj = pressio::ode::create_implicit_stepper(odeScheme, system);
-
     using lin_solver_t = pressio::linearsolvers::Solver<
         pressio::linearsolvers::iterative::Bicgstab, jacob_t>;
-    lin_solver_t linSolverObj;
+    TelemetryLinearSolver<lin_solver_t> linSolverObj;
+    // residual and Jacobian wall time only when it is written
+    const ProfiledSystem<AppType> profiledSystem(system,
+        parser.solverTelemetryFile().empty() ? nullptr : &linSolverObj.stats());
+    auto stepperObj = pressio::ode::create_implicit_stepper(odeScheme, profiledSystem);
     auto NonLinSolver = pressio::create_newton_solver(stepperObj, linSolverObj);
     // NonLinSolver.setStopCriterion(pressio::nonlinearsolvers::Stop::WhenAbsolutel2NormOfGradientBelowTolerance);
     // NonLinSolver.setStopTolerance(1e-5);
     NonLinSolver.setStopCriterion(pressio::nonlinearsolvers::Stop::WhenAbsolutel2NormOfCorrectionBelowTolerance);
     NonLinSolver.setStopTolerance(1e-5);
 
-    StateObserver Obs(parser.stateSamplingFreq());
-    RuntimeObserver Obs_run("runtime.bin");
+    // a restarted run appends to the outputs of the run it continues
+    CheckpointManager checkpoints(parser.checkpointConfig());
+    auto snapConfig = parser.snapshotConfig();
+    snapConfig.expectedRecords = expected_snapshot_count(parser.numSteps(), parser.stateSamplingFreq());
+    if (checkpoints.restarting()) {
+        truncate_output_files(checkpoints.restart());
+        snapConfig.append = true;
+    }
+    auto snapWriter = create_async_writer(snapConfig);
+    StateObserver Obs(parser.stateSamplingFreq(), full_state_config(snapConfig),
+        system.numDofPerCell(), parser.timeStepSize(), snapWriter);
+    PodObserver Obs_pod(parser.podConfig());
+    ProbeObserver Obs_probe(parser.probeConfig(), system.numDofPerCell(), {parser.meshDirFull()}, checkpoints.restartOrNull());
+    LiveStateObserver Obs_live(parser.liveConfig());
+    SolverTelemetryObserver Obs_solver(parser.solverTelemetryFile(), linSolverObj.stats(), checkpoints.restarting());
+    ObserverGroup Obs_all(Obs, Obs_pod, Obs_probe, Obs_live, Obs_solver);
+    RuntimeObserver Obs_run("runtime.bin", checkpoints.restarting());
+    auto checkpointOutputs = [&](Checkpoint & ckpt) {
+        Obs.flush();
+        Obs_run.flush();
+        ckpt.files.emplace_back(Obs.file().fileName(), Obs.file().size());
+        ckpt.files.emplace_back(Obs_run.fileName(), Obs_run.size());
+        if (Obs_solver.enabled()) {
+            Obs_solver.flush();
+            ckpt.files.emplace_back(Obs_solver.fileName(), Obs_solver.size());
+        }
+        Obs_probe.addOutputs(ckpt);
+    };
+    setupTimer.stop();
+
+    ScopedTimer loopTimer("timeLoop");
+    ProgressReporter progress(parser.progressConfig(), checkpoints.startStep(), parser.numSteps(), false);
+    advance_n_steps_checkpointed(
+        stepperObj, state,
+        parser.timeStepSize(), parser.numSteps(), odeScheme,
+        Obs_all, NonLinSolver, linSolverObj.stats(), checkpoints, checkpointOutputs, Obs_run, progress);
+    progress.finish();
+    loopTimer.stop();
 
-    const auto startTime = static_cast<scalar_t>(0.0);
-    auto runtimeStart = std::chrono::high_resolution_clock::now();
-    pressio::ode::advance_n_steps(
-        stepperObj, state, startTime,
-        parser.timeStepSize(),
-        pressio::ode::StepCount(parser.numSteps()),
-        Obs, NonLinSolver);
-    auto runtimeEnd = std::chrono::high_resolution_clock::now();
-    auto nsElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(runtimeEnd - runtimeStart).count();
-    double secElapsed = static_cast<double>(nsElapsed) * 1e-9;
-    Obs_run(secElapsed);
+    ScopedTimer finalizeTimer("finalize");
+    // a basis of part of the trajectory would pass for the full one
+    if (checkpoints.stopRequested()) {
+        if (parser.podConfig().enabled) std::cout << "POD: run stopped at a checkpoint, no basis written" << std::endl;
+    }
+    else {
+        Obs_pod.finalize();
+    }
 
     pressio::log::finalize();
 
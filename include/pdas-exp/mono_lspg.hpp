@@ -5,8 +5,11 @@
 #include "pressio/rom_subspaces.hpp"
 #include "pressio/rom_lspg_unsteady.hpp"
 #include "pda-schwarz/rom_utils.hpp"
+#include "checkpoint.hpp"
 #include "observer.hpp"
-#include <chrono>
+#include "memory.hpp"
+#include "solver_telemetry.hpp"
+#include "timers.hpp"
 
 template<class AppType, class ParserType>
 void run_mono_lspg(AppType & system, ParserType & parser)
@@ -32,23 +35,53 @@ void run_mono_lspg(AppType & system, ParserType & parser)
     using hessian_t          = Eigen::Matrix<scalar_type, -1, -1>;
     using solver_tag         = pressio::linearsolvers::direct::HouseholderQR;
     using linear_solver_t    = pressio::linearsolvers::Solver<solver_tag, hessian_t>;
-    linear_solver_t linSolverObj;
+    TelemetryLinearSolver<linear_solver_t> linSolverObj;
+    // residual and Jacobian wall time only when it is written
+    SolverStepStats * const assemblyStats = parser.solverTelemetryFile().empty() ? nullptr : &linSolverObj.stats();
 
+    ScopedTimer setupTimer("setup");
     const auto numDofsPerCell = system.numDofPerCell();
     auto state = system.initialCondition();
-    StateObserver Obs(parser.stateSamplingFreq());
-    RuntimeObserver Obs_run("runtime.bin");
-    const auto startTime = static_cast<typename app_t::scalar_type>(0.0);
+    // a restarted run appends to the outputs of the run it continues
+    CheckpointManager checkpoints(parser.checkpointConfig());
+    auto snapConfig = parser.snapshotConfig();
+    snapConfig.expectedRecords = expected_snapshot_count(parser.numSteps(), parser.stateSamplingFreq());
+    if (checkpoints.restarting()) {
+        truncate_output_files(checkpoints.restart());
+        snapConfig.append = true;
+    }
+    auto snapWriter = create_async_writer(snapConfig);
+    StateObserver Obs(parser.stateSamplingFreq(), snapConfig,
+        1, parser.timeStepSize(), snapWriter);
+    ProbeObserver Obs_probe(parser.probeConfig(), numDofsPerCell, {parser.meshDirFull()}, checkpoints.restartOrNull());
+    LiveStateObserver Obs_live(parser.liveConfig());
+    SolverTelemetryObserver Obs_solver(parser.solverTelemetryFile(), linSolverObj.stats(), checkpoints.restarting());
+    RuntimeObserver Obs_run("runtime.bin", checkpoints.restarting());
+    auto checkpointOutputs = [&](Checkpoint & ckpt) {
+        Obs.flush();
+        Obs_run.flush();
+        ckpt.files.emplace_back(Obs.file().fileName(), Obs.file().size());
+        ckpt.files.emplace_back(Obs_run.fileName(), Obs_run.size());
+        if (Obs_solver.enabled()) {
+            Obs_solver.flush();
+            ckpt.files.emplace_back(Obs_solver.fileName(), Obs_solver.size());
+        }
+        Obs_probe.addOutputs(ckpt);
+    };
     std::string icFile = parser.icFile();
 
     // UNSAMPLED ROM
     if (!parser.isHyper()) {
 
         // read and define full trial space
+        ScopedTimer basisTimer("basis");
+        MemoryScope basisMemory("basis");
         auto trans = pdas::read_vector_from_binary<scalar_type>(
             parser.romTransFile());
         auto basis = pdas::read_matrix_from_binary<scalar_type>(
             parser.romBasisFile(), parser.romModeCount());
+        basisMemory.stop();
+        basisTimer.stop();
         const auto trialSpace = pressio::rom::create_trial_column_subspace<
             reduced_state_type>(std::move(basis), std::move(trans), true);
 
@@ -83,8 +116,9 @@ void run_mono_lspg(AppType & system, ParserType & parser)
             }
         }
 
+        const ProfiledSystem<AppType> profiledSystem(system, assemblyStats);
         auto problem = pressio::rom::lspg::create_unsteady_problem(
-            parser.odeScheme(), trialSpace, system);
+            parser.odeScheme(), trialSpace, profiledSystem);
         auto stepperObj = problem.lspgStepper();
 
         auto NonLinSolver = pressio::create_gauss_newton_solver(stepperObj, linSolverObj);
@@ -94,35 +128,62 @@ void run_mono_lspg(AppType & system, ParserType & parser)
         NonLinSolver.setStopCriterion(pnlins::Stop::WhenAbsolutel2NormOfCorrectionBelowTolerance);
         NonLinSolver.setStopTolerance(1e-5);
 
+        // error against the reference trajectory, if requested
+        RomErrorObserver Obs_err(parser.errorConfig(), trialSpace, numDofsPerCell, checkpoints.restartOrNull());
+        auto romOutputs = [&](Checkpoint & ckpt) {
+            checkpointOutputs(ckpt);
+            Obs_err.addOutputs(ckpt);
+        };
+        Obs_probe.setReducedBasis(0, trialSpace.basisOfTranslatedSpace(), trialSpace.translationVector());
+        ObserverGroup Obs_all(Obs, Obs_err, Obs_probe, Obs_live, Obs_solver);
+        setupTimer.stop();
+
         // execute
-        auto runtimeStart = std::chrono::high_resolution_clock::now();
-        pressio::ode::advance_n_steps(
-            stepperObj, reducedState, startTime,
-            parser.timeStepSize(),
-            pressio::ode::StepCount(parser.numSteps()),
-            Obs, NonLinSolver);
-        auto runtimeEnd = std::chrono::high_resolution_clock::now();
-        auto nsElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(runtimeEnd - runtimeStart).count();
-        double secElapsed = static_cast<double>(nsElapsed) * 1e-9;
-        Obs_run(secElapsed);
+        ScopedTimer loopTimer("timeLoop");
+        ProgressReporter progress(parser.progressConfig(), checkpoints.startStep(), parser.numSteps(), false);
+        advance_n_steps_checkpointed(
+            stepperObj, reducedState,
+            parser.timeStepSize(), parser.numSteps(), parser.odeScheme(),
+            Obs_all, NonLinSolver, linSolverObj.stats(), checkpoints, romOutputs, Obs_run, progress);
+        progress.finish();
+        loopTimer.stop();
+
+        ScopedTimer finalizeTimer("finalize");
+        Obs_err.finalize();
 
     }
     // HYPER-REDUCED ROM
     else {
+        ScopedTimer meshTimer("mesh");
+        MemoryScope meshMemory("mesh");
         const auto meshObjHyp = pda::load_cellcentered_uniform_mesh_eigen(parser.meshDirHyper());
+        meshMemory.stop();
+        meshTimer.stop();
+        ScopedTimer problemTimer("problem");
+        MemoryScope problemMemory("problem");
         auto systemHyp = pda::create_problem_eigen(
             meshObjHyp, parser.probId(), parser.fluxOrder(),
             parser.icFlag(), parser.userParams()
         );
+        problemMemory.stop();
+        problemTimer.stop();
 
         // read and define sampled trial space
+        ScopedTimer basisTimer("basis");
+        MemoryScope basisMemory("basis");
         auto transFull = pdas::read_vector_from_binary<scalar_type>(
             parser.romTransFile());
         auto basisFull = pdas::read_matrix_from_binary<scalar_type>(
             parser.romBasisFile(), parser.romModeCount());
         const auto stencilGids = pdas::create_cell_gids_vector_and_fill_from_ascii(parser.hyperStencilFile());
+        basisMemory.stop();
+        basisTimer.stop();
+        ScopedTimer reduceTimer("reduceOnStencil");
+        MemoryScope reduceMemory("reduceOnStencil");
         auto transHyp = pdas::reduce_vector_on_stencil_mesh(transFull, stencilGids, numDofsPerCell);
         auto basisHyp = pdas::reduce_matrix_on_stencil_mesh(basisFull, stencilGids, numDofsPerCell);
+        reduceMemory.stop();
+        reduceTimer.stop();
         const auto trialSpaceFull = pressio::rom::create_trial_column_subspace<
             reduced_state_type>(std::move(basisFull), std::move(transFull), true);
         const auto trialSpaceHyp = pressio::rom::create_trial_column_subspace<
@@ -163,7 +224,8 @@ void run_mono_lspg(AppType & system, ParserType & parser)
         pdas::HypRedUpdater<scalar_type> hrUpdater(numDofsPerCell, parser.hyperStencilFile(), parser.hyperSampleFile());
 
         // define ROM problem
-        auto problem = plspg::create_unsteady_problem(parser.odeScheme(), trialSpaceHyp, systemHyp, hrUpdater);
+        const ProfiledSystem<decltype(systemHyp)> profiledSystemHyp(systemHyp, assemblyStats);
+        auto problem = plspg::create_unsteady_problem(parser.odeScheme(), trialSpaceHyp, profiledSystemHyp, hrUpdater);
         auto stepperObj = problem.lspgStepper();
 
         // nonlinear solver
@@ -181,17 +243,28 @@ void run_mono_lspg(AppType & system, ParserType & parser)
         NonLinSolver.setStopCriterion(pnlins::Stop::WhenAbsolutel2NormOfCorrectionBelowTolerance);
         NonLinSolver.setStopTolerance(1e-5);
 
+        // error against the reference trajectory, if requested
+        RomErrorObserver Obs_err(parser.errorConfig(), trialSpaceFull, numDofsPerCell, checkpoints.restartOrNull());
+        auto romOutputs = [&](Checkpoint & ckpt) {
+            checkpointOutputs(ckpt);
+            Obs_err.addOutputs(ckpt);
+        };
+        Obs_probe.setReducedBasis(0, trialSpaceFull.basisOfTranslatedSpace(), trialSpaceFull.translationVector());
+        ObserverGroup Obs_all(Obs, Obs_err, Obs_probe, Obs_live, Obs_solver);
+        setupTimer.stop();
+
         // execute
-        auto runtimeStart = std::chrono::high_resolution_clock::now();
-        pressio::ode::advance_n_steps(
-            stepperObj, reducedState, startTime,
-            parser.timeStepSize(),
-            pressio::ode::StepCount(parser.numSteps()),
-            Obs, NonLinSolver);
-        auto runtimeEnd = std::chrono::high_resolution_clock::now();
-        auto nsElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(runtimeEnd - runtimeStart).count();
-        double secElapsed = static_cast<double>(nsElapsed) * 1e-9;
-        Obs_run(secElapsed);
+        ScopedTimer loopTimer("timeLoop");
+        ProgressReporter progress(parser.progressConfig(), checkpoints.startStep(), parser.numSteps(), false);
+        advance_n_steps_checkpointed(
+            stepperObj, reducedState,
+            parser.timeStepSize(), parser.numSteps(), parser.odeScheme(),
+            Obs_all, NonLinSolver, linSolverObj.stats(), checkpoints, romOutputs, Obs_run, progress);
+        progress.finish();
+        loopTimer.stop();
+
+        ScopedTimer finalizeTimer("finalize");
+        Obs_err.finalize();
 
     }
 
@@ -2,22 +2,110 @@
 #ifndef PDAS_EXPERIMENTS_OBSERVER_HPP_
 #define PDAS_EXPERIMENTS_OBSERVER_HPP_
 
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include <tuple>
+
+#include "checkpoint.hpp"
+#include "error_norms.hpp"
+#include "live_state.hpp"
+#include "probes.hpp"
+#include "snapshot_io.hpp"
+#include "streaming_pod.hpp"
+
 class StateObserver
 {
 public:
-    StateObserver(const std::string & f0, int freq)
-        : myfile_(f0,  std::ios::out | std::ios::binary),
-        sampleFreq_(freq){}
+    StateObserver(const std::string & f0, int freq, const SnapshotConfig & config,
+                  int nvars, double dt, std::shared_ptr<AsyncWriter> writer = nullptr)
+        : file_(f0, config, {nvars}, freq, dt, std::move(writer)),
+        sampleFreq_(freq), sampler_(config), blocks_(1){}
 
-    explicit StateObserver(int freq)
-        : myfile_("state_snapshots.bin",  std::ios::out | std::ios::binary),
-        sampleFreq_(freq){}
+    StateObserver(int freq, const SnapshotConfig & config, int nvars, double dt,
+                  std::shared_ptr<AsyncWriter> writer = nullptr)
+        : StateObserver("state_snapshots.bin", freq, config, nvars, dt, std::move(writer)){}
 
     StateObserver() = default;
-    StateObserver & operator=(StateObserver &) = default;
+    StateObserver(StateObserver &&) = default;
     StateObserver & operator=(StateObserver &&) = default;
 
-    ~StateObserver(){ myfile_.close(); }
+    template<typename TimeType, typename ObservableType>
+    std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
+    operator()(pressio::ode::StepCount step,
+            const TimeType timeIn,
+            const ObservableType & state)
+    {
+        if (step.get() % sampleFreq_ != 0) return;
+
+        blocks_[0] = {reinterpret_cast<const char*>(&state(0)), static_cast<std::size_t>(state.size())};
+        if (sampler_.accept(step.get(), blocks_, sizeof(typename ObservableType::Scalar))) {
+            file_.write(step.get(), static_cast<double>(timeIn), blocks_, sizeof(typename ObservableType::Scalar));
+        }
+    }
+
+    // push everything written so far to disk
+    void flush() { file_.flush(); }
+
+    const SnapshotFileWriter & file() const { return file_; }
+
+private:
+    SnapshotFileWriter file_;
+    int sampleFreq_ = {};
+    AdaptiveSampler sampler_;
+    std::vector<std::pair<const char *, std::size_t>> blocks_;  // the sampled state, kept so a sample does not allocate
+};
+
+// Single container file for decomposed runs: one record per sampled step, holding one block per subdomain
+class DecompStateObserver
+{
+public:
+    DecompStateObserver(const std::string & f0, int freq, const SnapshotConfig & config,
+                        const std::vector<int> & nvarsVec, double dt,
+                        std::shared_ptr<AsyncWriter> writer = nullptr)
+        : file_(f0, config, nvarsVec, freq, dt, std::move(writer)),
+        sampleFreq_(freq), sampler_(config), blocks_(nvarsVec.size()){}
+
+    DecompStateObserver() = default;
+    DecompStateObserver(DecompStateObserver &&) = default;
+    DecompStateObserver & operator=(DecompStateObserver &&) = default;
+
+    // register the current state of a subdomain, must be called for every subdomain before operator()
+    template<typename ObservableType>
+    std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
+    setBlock(int domIdx, const ObservableType & state)
+    {
+        static_assert(std::is_same<typename ObservableType::Scalar, double>::value,
+            "DecompStateObserver stores double states");
+        blocks_[domIdx] = {reinterpret_cast<const char*>(&state(0)), static_cast<std::size_t>(state.size())};
+    }
+
+    template<typename TimeType>
+    void operator()(pressio::ode::StepCount step, const TimeType timeIn)
+    {
+        if ((step.get() % sampleFreq_ == 0) && sampler_.accept(step.get(), blocks_, sizeof(double))) {
+            file_.write(step.get(), static_cast<double>(timeIn), blocks_, sizeof(double));
+        }
+    }
+
+    void flush() { file_.flush(); }
+
+    const SnapshotFileWriter & file() const { return file_; }
+
+private:
+    SnapshotFileWriter file_;
+    int sampleFreq_ = {};
+    AdaptiveSampler sampler_;
+    std::vector<std::pair<const char *, std::size_t>> blocks_;
+};
+
+// Builds a POD basis from the trajectory as it is computed, instead of from snapshot files.
+// Snapshots are buffered and folded into the SVD a batch at a time; finalize() writes the basis.
+class PodObserver
+{
+public:
+    PodObserver(const PodConfig & config)
+        : config_(config), pod_(config.center, config.maxModes){}
 
     template<typename TimeType, typename ObservableType>
     std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
@@ -25,45 +113,433 @@ public:
             const TimeType /*timeIn*/,
             const ObservableType & state)
     {
-        if (step.get() % sampleFreq_ == 0) {
-            const std::size_t ext = state.size()*sizeof(typename ObservableType::Scalar);
-            myfile_.write(reinterpret_cast<const char*>(&state(0)), ext);
+        if (!config_.enabled || (step.get() % config_.sampleFreq != 0)) return;
+
+        if (batch_.rows() != state.size()) batch_.resize(state.size(), config_.batchSize);
+        batch_.col(batchCount_++) = state.template cast<double>();
+        if (batchCount_ == config_.batchSize) update();
+    }
+
+    // fold in leftover snapshots, truncate by energy and write basis and center
+    void finalize()
+    {
+        if (!config_.enabled) return;
+        update();
+
+        const int numModes = pod_.modes_for_energy(config_.energy);
+        write_matrix_to_binary(config_.basisFile, pod_.basis().leftCols(numModes));
+        write_matrix_to_binary(config_.centerFile, pod_.center());
+        std::cout << "POD: " << pod_.numSnapshots() << " snapshots, " << numModes
+                  << " modes retaining " << pod_.energy_fraction(numModes) << " of the energy" << std::endl;
+    }
+
+private:
+    void update()
+    {
+        if (batchCount_ == 0) return;
+        pod_.update(batch_.leftCols(batchCount_));
+        batchCount_ = 0;
+    }
+
+    PodConfig config_;
+    StreamingPod pod_;
+    Eigen::MatrixXd batch_;
+    int batchCount_ = 0;
+};
+
+// an error history continues from its running sums on restart, so the space-time norms cover the whole run
+inline void add_error_history(Checkpoint & ckpt, ErrorHistory & history)
+{
+    history.flush();
+    ckpt.files.emplace_back(history.fileName(), history.size());
+    ckpt.sums.emplace_back(history.fileName(), history.sums());
+}
+
+// Error of a ROM against a reference trajectory. The full state is reconstructed
+// from the trial space only at steps that are evaluated.
+template<class TrialSpaceType>
+class RomErrorObserver
+{
+public:
+    // restart: the checkpoint a restarted run continues from, whose error history is appended to
+    RomErrorObserver(const ErrorConfig & config, const TrialSpaceType & trialSpace, int nvars,
+                     const Checkpoint * restart = nullptr)
+        : config_(config), trialSpace_(trialSpace)
+    {
+        if (!config_.enabled) return;
+        reference_ = std::make_unique<ReferenceTrajectory>(config_.reference, config_.referenceSampleFreq);
+        const std::string fileName = "error_history.bin";
+        history_ = std::make_unique<ErrorHistory>(fileName, nvars, restart ? restart->findSums(fileName) : nullptr);
+    }
+
+    template<typename TimeType, typename ObservableType>
+    std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
+    operator()(pressio::ode::StepCount step,
+            const TimeType timeIn,
+            const ObservableType & reducedState)
+    {
+        if (!config_.enabled || (step.get() % config_.sampleFreq != 0)) return;
+
+        fullState_ = trialSpace_.translationVector() + trialSpace_.basisOfTranslatedSpace() * reducedState;
+        const double * ref = reference_->find(step.get(), fullState_.size());
+        if (ref) history_->add(step.get(), static_cast<double>(timeIn), fullState_.data(), ref, fullState_.size());
+    }
+
+    void finalize() { if (history_) history_->finalize(); }
+
+    // the history file and its running sums, for a checkpoint
+    void addOutputs(Checkpoint & ckpt)
+    {
+        if (!history_) return;
+        add_error_history(ckpt, *history_);
+    }
+
+private:
+    ErrorConfig config_;
+    const TrialSpaceType & trialSpace_;
+    std::unique_ptr<ReferenceTrajectory> reference_;
+    std::unique_ptr<ErrorHistory> history_;
+    Eigen::VectorXd fullState_;
+};
+
+// Per-subdomain errors of a decomposed run. The reference is either a container file with
+// one block per subdomain, or one file per subdomain at <reference>_<domIdx>.bin
+class DecompErrorObserver
+{
+public:
+    DecompErrorObserver() = default;
+
+    DecompErrorObserver(const ErrorConfig & config, int ndomains, int nvars, const Checkpoint * restart = nullptr)
+        : config_(config)
+    {
+        if (!config_.enabled) return;
+
+        std::ifstream single(config_.reference);
+        if (single.good()) {
+            single.close();
+            references_.push_back(std::make_unique<ReferenceTrajectory>(config_.reference, config_.referenceSampleFreq));
+            if (references_[0]->numBlocks() != static_cast<std::size_t>(ndomains)) {
+                throw std::runtime_error("DecompErrorObserver: " + config_.reference + " does not hold one block per subdomain");
+            }
+        }
+        else {
+            for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+                references_.push_back(std::make_unique<ReferenceTrajectory>(
+                    config_.reference + "_" + std::to_string(domIdx) + ".bin", config_.referenceSampleFreq));
+            }
+        }
+        for (int domIdx = 0; domIdx < ndomains; ++domIdx) {
+            const std::string fileName = "error_history_" + std::to_string(domIdx) + ".bin";
+            histories_.push_back(std::make_unique<ErrorHistory>(
+                fileName, nvars, restart ? restart->findSums(fileName) : nullptr));
+        }
+    }
+
+    bool samples(int step) const { return config_.enabled && (step % config_.sampleFreq == 0); }
+
+    template<typename ObservableType>
+    void operator()(int domIdx, pressio::ode::StepCount step, double timeIn, const ObservableType & fullState)
+    {
+        static_assert(std::is_same<typename ObservableType::Scalar, double>::value,
+            "DecompErrorObserver compares double states");
+        const bool container = (references_.size() == 1);
+        auto & reference = container ? references_[0] : references_[domIdx];
+        const double * ref = reference->find(step.get(), fullState.size(), container ? domIdx : 0);
+        if (ref) histories_[domIdx]->add(step.get(), timeIn, &fullState(0), ref, fullState.size());
+    }
+
+    void finalize() { for (auto & history : histories_) history->finalize(); }
+
+    void addOutputs(Checkpoint & ckpt)
+    {
+        for (auto & history : histories_) add_error_history(ckpt, *history);
+    }
+
+private:
+    ErrorConfig config_ = {};
+    std::vector<std::unique_ptr<ReferenceTrajectory>> references_;
+    std::vector<std::unique_ptr<ErrorHistory>> histories_;
+};
+
+// Records selected cells at their own sampling rate, for one or more (sub)domains.
+// Domains given a reduced basis reconstruct only the probed rows from the reduced state.
+class ProbeObserver
+{
+public:
+    ProbeObserver() = default;
+
+    // restart: the checkpoint a restarted run continues from, the probe file is appended to if it lists it
+    ProbeObserver(const ProbeConfig & config, int nvars, const std::vector<std::string> & meshDirs,
+                  const Checkpoint * restart = nullptr)
+        : config_(config), nvars_(nvars), domains_(meshDirs.size())
+    {
+        if (!config_.enabled) return;
+
+        // grouped by domain, each domain's values are contiguous in a record
+        const auto cells = select_probe_cells(config_, meshDirs);
+        for (std::size_t cellIdx = 0; cellIdx < cells.size(); ++cellIdx) {
+            auto & domain = domains_[cells[cellIdx].first];
+            if (domain.dofs.empty()) domain.offset = cellIdx * nvars_;
+            for (int var = 0; var < nvars_; ++var) domain.dofs.push_back(cells[cellIdx].second * nvars_ + var);
+        }
+        if (cells.empty()) std::cout << "Probes: no cells selected" << std::endl;
+        values_.resize(cells.size() * nvars_);
+        file_ = ProbeFileWriter(config_.file, nvars_, cells, config_.bufferRecords,
+            restart && restart->hasFile(config_.file));
+    }
+
+    // reduced states of this domain are mapped through the probed rows of basis and translation
+    template<typename BasisType, typename TransType>
+    void setReducedBasis(int domIdx, const BasisType & basis, const TransType & trans)
+    {
+        if (!config_.enabled) return;
+        auto & domain = domains_[domIdx];
+        domain.basisRows.resize(domain.dofs.size(), basis.cols());
+        domain.transRows.resize(domain.dofs.size());
+        for (std::size_t row = 0; row < domain.dofs.size(); ++row) {
+            domain.basisRows.row(row) = basis.row(domain.dofs[row]);
+            domain.transRows(row) = trans(domain.dofs[row]);
+        }
+        domain.reduced = true;
+    }
+
+    bool samples(int step) const { return config_.enabled && (step % config_.sampleFreq == 0); }
+
+    template<typename ObservableType>
+    void setState(int domIdx, const ObservableType & state)
+    {
+        const auto & domain = domains_[domIdx];
+        if (domain.dofs.empty()) return;
+        Eigen::Map<Eigen::VectorXd> out(values_.data() + domain.offset, domain.dofs.size());
+        if (domain.reduced) {
+            out = domain.transRows + domain.basisRows * state.template cast<double>();
+        }
+        else {
+            for (std::size_t row = 0; row < domain.dofs.size(); ++row) out(row) = state(domain.dofs[row]);
         }
     }
 
+    // write the values of all domains set since the last commit
+    template<typename TimeType>
+    void commit(pressio::ode::StepCount step, const TimeType timeIn)
+    {
+        file_.write(step.get(), static_cast<double>(timeIn), values_);
+    }
+
+    template<typename TimeType, typename ObservableType>
+    std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
+    operator()(pressio::ode::StepCount step,
+            const TimeType timeIn,
+            const ObservableType & state)
+    {
+        if (!samples(step.get())) return;
+        setState(0, state);
+        commit(step, timeIn);
+    }
+
+    void flush() { if (config_.enabled) file_.flush(); }
+
+    // the probe file with its buffered records written, for a checkpoint
+    void addOutputs(Checkpoint & ckpt)
+    {
+        if (!config_.enabled) return;
+        file_.flush();
+        ckpt.files.emplace_back(file_.fileName(), file_.size());
+    }
+
 private:
-    std::ofstream myfile_;
-    int sampleFreq_ = {};
+    struct Domain
+    {
+        std::size_t offset = 0;     // first value of this domain in a record
+        std::vector<int> dofs;
+        bool reduced = false;
+        Eigen::MatrixXd basisRows;
+        Eigen::VectorXd transRows;
+    };
+
+    ProbeConfig config_ = {};
+    int nvars_ = 1;
+    std::vector<Domain> domains_;
+    std::vector<double> values_;
+    ProbeFileWriter file_;
 };
 
+// Publishes sampled states to a shared memory ring buffer for monitoring processes.
+// Decomposed runs publish one block per subdomain, registered with setBlock() before commit().
+class LiveStateObserver
+{
+public:
+    LiveStateObserver() = default;
+
+    LiveStateObserver(const LiveConfig & config, int numBlocks = 1)
+        : config_(config), blocks_(numBlocks)
+    {
+        if (config_.enabled) publisher_ = LiveStatePublisher(config_.name, config_.slots);
+    }
+
+    bool samples(int step) const { return config_.enabled && (step % config_.sampleFreq == 0); }
+
+    template<typename TimeType, typename ObservableType>
+    std::enable_if_t< pressio::is_vector_eigen<ObservableType>::value >
+    operator()(pressio::ode::StepCount step, const TimeType timeIn, const ObservableType & state)
+    {
+        if (!samples(step.get())) return;
+        setBlock(0, state);
+        commit(step, timeIn);
+    }
+
+    template<typename ObservableType>
+    void setBlock(int domIdx, const ObservableType & state)
+    {
+        static_assert(std::is_same<typename ObservableType::Scalar, double>::value,
+            "LiveStateObserver publishes double states");
+        blocks_[domIdx] = {&state(0), static_cast<std::size_t>(state.size())};
+    }
+
+    template<typename TimeType>
+    void commit(pressio::ode::StepCount step, const TimeType timeIn)
+    {
+        publisher_.publish(step.get(), static_cast<double>(timeIn), blocks_);
+    }
+
+private:
+    LiveConfig config_ = {};
+    LiveStatePublisher publisher_;
+    std::vector<std::pair<const double *, std::size_t>> blocks_;
+};
+
+// Forwards each pressio observer call to several observers, in order
+template<class ... ObserverTypes>
+class ObserverGroup
+{
+public:
+    ObserverGroup(ObserverTypes & ... observers)
+        : observers_(observers...){}
+
+    template<typename TimeType, typename ObservableType>
+    void operator()(pressio::ode::StepCount step,
+            const TimeType timeIn,
+            const ObservableType & state)
+    {
+        std::apply([&](auto & ... obs){ (obs(step, timeIn, state), ...); }, observers_);
+    }
+
+private:
+    std::tuple<ObserverTypes & ...> observers_;
+};
+
+/*
+    Runtime file, version 3:
+    header: char magic[8] "PDASRUNT", std::uint32_t version, std::uint32_t numColumns,
+            then per column: std::uint64_t nameLength, char x nameLength
+    per outer step: std::int64_t step, std::uint64_t numSubiters, std::uint64_t nonlinearIters,
+            double x numColumns, wall-clock seconds
+    numSubiters counts Schwarz subiterations and is notApplicable in monolithic runs; nonlinearIters
+    counts Newton / Gauss-Newton iterations and is notApplicable in decomposed runs, whose subdomain
+    solvers are driven by pda-schwarz.
+    Decomposed runs add a column per subdomain, "domain<i>", for its post-step work (snapshot and kept
+    states) on the thread owning it, and one per thread the team can have, "wait<t>", for its waits at
+    the time loop's barriers, NaN for threads outside the team.
+    Version 2 records have no nonlinearIters, and monolithic ones store numSubiters as 1.
+    Version 1 files have no header and one record per step: std::size_t numSubiters, double runtime.
+*/
 class RuntimeObserver
 {
 public:
-    RuntimeObserver(const std::string & f0)
-        : timeFile_(f0, std::ios::out | std::ios::binary)
-    {}
+    static constexpr char magic[8] = {'P', 'D', 'A', 'S', 'R', 'U', 'N', 'T'};
+    static constexpr std::uint32_t version = 3;
+    static constexpr std::uint64_t notApplicable = std::numeric_limits<std::uint64_t>::max();
+
+    // solve: stepper or Schwarz controller step, including subdomain exchanges and convergence checks
+    // observers: snapshot, error, probe and live output; checkpoint: checkpoint written before the step
+    static std::vector<std::string> defaultColumns() { return {"solve", "observers", "checkpoint"}; }
+
+    // append continues the file of a restarted run, which must have the same columns
+    RuntimeObserver(const std::string & f0, bool append = false,
+                    const std::vector<std::string> & columns = defaultColumns())
+        : fileName_(f0), numColumns_(columns.size()),
+        timeFile_(f0, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc))
+    {
+        if (append) {
+            std::ifstream fin(f0, std::ios::in | std::ios::binary);
+            char fileMagic[8] = {};
+            std::uint32_t head[2] = {};
+            fin.read(fileMagic, sizeof(fileMagic));
+            fin.read(reinterpret_cast<char*>(head), sizeof(head));
+            if (!fin || !std::equal(fileMagic, fileMagic + 8, magic) || (head[0] != version)) {
+                throw std::runtime_error(f0 + " is not a version " + std::to_string(version)
+                    + " runtime file, cannot append to it");
+            }
+            std::vector<std::string> fileColumns(head[1]);
+            for (auto & column : fileColumns) {
+                std::uint64_t nameLength = 0;
+                fin.read(reinterpret_cast<char*>(&nameLength), sizeof(std::uint64_t));
+                column.resize(nameLength);
+                fin.read(&column[0], nameLength);
+            }
+            if (!fin || (fileColumns != columns)) {
+                throw std::runtime_error(f0 + " has other columns than this run (" + std::to_string(fileColumns.size())
+                    + " vs " + std::to_string(columns.size()) + "), restart with the same subdomains and threads");
+            }
+            fin.seekg(0, std::ios::end);
+            size_ = static_cast<std::uint64_t>(fin.tellg());
+            return;
+        }
+
+        const std::uint32_t head[2] = {version, static_cast<std::uint32_t>(numColumns_)};
+        timeFile_.write(magic, sizeof(magic));
+        timeFile_.write(reinterpret_cast<const char*>(head), sizeof(head));
+        size_ += sizeof(magic) + sizeof(head);
+        for (const auto & column : columns) {
+            const std::uint64_t nameLength = column.size();
+            timeFile_.write(reinterpret_cast<const char*>(&nameLength), sizeof(std::uint64_t));
+            timeFile_.write(column.data(), column.size());
+            size_ += sizeof(std::uint64_t) + column.size();
+        }
+    }
 
     ~RuntimeObserver() { timeFile_.close(); }
 
-    void operator() (double runtimeVal, int itersVal)
+    // one value per column, in seconds; a braced list, so recording a step does not allocate
+    void operator() (int step, std::uint64_t numSubiters, std::uint64_t nonlinearIters,
+                     std::initializer_list<double> phaseTimes)
     {
-        // number of subiterations, total runtime for single outer loop iteration
-        std::size_t iters_st = static_cast<std::size_t>(itersVal);
-        timeFile_.write(reinterpret_cast<const char*>(&iters_st), sizeof(std::size_t));
-        timeFile_.write(reinterpret_cast<const char*>(&runtimeVal), sizeof(double));
+        write(step, numSubiters, nonlinearIters, phaseTimes.begin(), phaseTimes.size());
     }
 
-    void operator() (double runtimeVal)
+    // the same from a vector kept across steps, for column counts known at run time
+    void operator() (int step, std::uint64_t numSubiters, std::uint64_t nonlinearIters,
+                     const std::vector<double> & phaseTimes)
     {
-        // Overload for handling non-Schwarz input, have to manually time it and pass total runtime
-        // Just write it as if there's one iteration, one subiteration
-        std::size_t one = static_cast<std::size_t>(1);
-        timeFile_.write(reinterpret_cast<const char*>(&one), sizeof(std::size_t));
-        timeFile_.write(reinterpret_cast<const char*>(&runtimeVal), sizeof(double));
+        write(step, numSubiters, nonlinearIters, phaseTimes.data(), phaseTimes.size());
     }
 
+    void flush() { timeFile_.flush(); }
+
+    const std::string & fileName() const { return fileName_; }
+
+    std::uint64_t size() const { return size_; }
+
 private:
+    void write(int step, std::uint64_t numSubiters, std::uint64_t nonlinearIters,
+               const double * phaseTimes, std::size_t numTimes)
+    {
+        if (numTimes != numColumns_) {
+            throw std::runtime_error("RuntimeObserver: got " + std::to_string(numTimes)
+                + " phase times, expected " + std::to_string(numColumns_));
+        }
+        const std::int64_t step_st = step;
+        const std::uint64_t iters_st[2] = {numSubiters, nonlinearIters};
+        timeFile_.write(reinterpret_cast<const char*>(&step_st), sizeof(std::int64_t));
+        timeFile_.write(reinterpret_cast<const char*>(iters_st), sizeof(iters_st));
+        timeFile_.write(reinterpret_cast<const char*>(phaseTimes), numColumns_ * sizeof(double));
+        size_ += sizeof(std::int64_t) + sizeof(iters_st) + numColumns_ * sizeof(double);
+    }
+
+    std::string fileName_;
+    std::size_t numColumns_ = 0;
     std::ofstream timeFile_;
+    std::uint64_t size_ = 0;
 };
 
 #endif
@@ -10,6 +10,14 @@
 #include "yaml-cpp/parser.h"
 #include "yaml-cpp/yaml.h"
 
+#include "checkpoint.hpp"
+#include "error_norms.hpp"
+#include "live_state.hpp"
+#include "probes.hpp"
+#include "progress.hpp"
+#include "snapshot_io.hpp"
+#include "streaming_pod.hpp"
+
 // TODO: validation of inputs
 
 // parsing time stepping scheme
@@ -51,6 +59,16 @@ protected:
     std::string problemName_        = "";
     int icFlag_                     = -1;
     std::unordered_map<std::string, ScalarType> userParams_ = {};
+    SnapshotConfig snapshotConfig_  = {};
+    ErrorConfig errorConfig_        = {};
+    ProbeConfig probeConfig_        = {};
+    LiveConfig liveConfig_          = {};
+    ProgressConfig progressConfig_  = {};
+    CheckpointConfig checkpointConfig_ = {};
+    std::string timersFile_         = "";
+    std::string traceFile_          = "";
+    std::string perfCountersFile_   = "";
+    std::string memoryFile_         = "";
 
 public:
     ParserCommon() = delete;
@@ -67,6 +85,16 @@ public:
     auto loglevel()             const { return loglevel_; }
     auto logtarget()            const { return logtarget_; }
     auto logfile()              const { return logfile_; }
+    auto snapshotConfig()       const { return snapshotConfig_; }
+    auto errorConfig()          const { return errorConfig_; }
+    auto probeConfig()          const { return probeConfig_; }
+    auto liveConfig()           const { return liveConfig_; }
+    auto progressConfig()       const { return progressConfig_; }
+    auto checkpointConfig()     const { return checkpointConfig_; }
+    auto timersFile()           const { return timersFile_; }
+    auto traceFile()            const { return traceFile_; }
+    auto perfCountersFile()     const { return perfCountersFile_; }
+    auto memoryFile()           const { return memoryFile_; }
 
 private:
     void parseImpl(YAML::Node & node)
@@ -117,6 +145,210 @@ private:
             logfile_ = node[entry].as<std::string>();
         }
 
+        // snapshot output, headerless stream of doubles by default
+        entry = "snapshotFormat";
+        if (node[entry]) snapshotConfig_.format = string_to_snapshot_format(node[entry].as<std::string>());
+
+        entry = "snapshotCodec";
+        if (node[entry]) snapshotConfig_.codec = string_to_snapshot_codec(node[entry].as<std::string>());
+        if ((snapshotConfig_.codec != SnapshotCodecType::None) && (snapshotConfig_.format == SnapshotFormat::Raw)) {
+            throw std::runtime_error("Input: snapshotCodec requires snapshotFormat: indexed");
+        }
+
+        if (snapshotConfig_.codec == SnapshotCodecType::Lossy) {
+            entry = "snapshotErrorBound";
+            if (node[entry]) snapshotConfig_.errorBound = node[entry].as<double>();
+            else throw std::runtime_error("Input: missing " + entry);
+            if (!(snapshotConfig_.errorBound > 0.0)) throw std::runtime_error("Input: snapshotErrorBound must be positive");
+
+            entry = "snapshotErrorBoundMode";
+            if (node[entry]) snapshotConfig_.errorBoundMode = string_to_error_bound_mode(node[entry].as<std::string>());
+        }
+
+        entry = "snapshotPrecision";
+        if (node[entry]) snapshotConfig_.precision = string_to_snapshot_precision(node[entry].as<std::string>());
+        if ((snapshotConfig_.precision != SnapshotPrecision::Float64) && (snapshotConfig_.format == SnapshotFormat::Raw)) {
+            throw std::runtime_error("Input: snapshotPrecision requires snapshotFormat: indexed");
+        }
+
+        // per-variable contiguous chunks, so a single variable can be read on its own
+        entry = "snapshotLayout";
+        if (node[entry]) snapshotConfig_.layout = string_to_snapshot_layout(node[entry].as<std::string>());
+        if ((snapshotConfig_.layout != SnapshotLayout::CellInterleaved) &&
+            ((snapshotConfig_.format == SnapshotFormat::Raw) || (snapshotConfig_.codec != SnapshotCodecType::None))) {
+            throw std::runtime_error("Input: snapshotLayout: variable requires snapshotFormat: indexed and no snapshotCodec");
+        }
+
+        entry = "snapshotKeyframeInterval";
+        if (node[entry]) {
+            snapshotConfig_.keyframeInterval = node[entry].as<int>();
+            if (snapshotConfig_.keyframeInterval < 0) throw std::runtime_error("Input: snapshotKeyframeInterval must be non-negative");
+        }
+
+        entry = "snapshotContainer";
+        if (node[entry]) snapshotConfig_.container = node[entry].as<bool>();
+        if (snapshotConfig_.container && (snapshotConfig_.format == SnapshotFormat::Raw)) {
+            throw std::runtime_error("Input: snapshotContainer requires snapshotFormat: indexed");
+        }
+
+        // change-triggered sampling, states are examined every stateSamplingFreq steps
+        entry = "snapshotAdaptiveThreshold";
+        if (node[entry]) snapshotConfig_.adaptiveThreshold = node[entry].as<double>();
+        if (snapshotConfig_.adaptiveThreshold < 0.0) throw std::runtime_error("Input: snapshotAdaptiveThreshold must be non-negative");
+        if ((snapshotConfig_.adaptiveThreshold > 0.0) && (snapshotConfig_.format == SnapshotFormat::Raw)) {
+            throw std::runtime_error("Input: snapshotAdaptiveThreshold requires snapshotFormat: indexed");
+        }
+
+        entry = "snapshotAdaptiveMinInterval";
+        if (node[entry]) snapshotConfig_.adaptiveMinInterval = node[entry].as<int>();
+        if (snapshotConfig_.adaptiveMinInterval < 1) throw std::runtime_error("Input: snapshotAdaptiveMinInterval must be positive");
+
+        entry = "snapshotAdaptiveMaxInterval";
+        if (node[entry]) snapshotConfig_.adaptiveMaxInterval = node[entry].as<int>();
+        if ((snapshotConfig_.adaptiveMaxInterval != 0) &&
+            (snapshotConfig_.adaptiveMaxInterval < snapshotConfig_.adaptiveMinInterval)) {
+            throw std::runtime_error("Input: snapshotAdaptiveMaxInterval must be 0 or at least snapshotAdaptiveMinInterval");
+        }
+
+        // only honoured for uncompressed output, whose size is known ahead of time
+        entry = "snapshotPreallocate";
+        if (node[entry]) snapshotConfig_.preallocate = node[entry].as<bool>();
+
+        // reduced-state files only: records gathered in memory and written in bulk
+        entry = "snapshotBatchRecords";
+        if (node[entry]) {
+            const int batchRecords = node[entry].as<int>();
+            if (batchRecords < 0) throw std::runtime_error("Input: snapshotBatchRecords must be non-negative");
+            snapshotConfig_.batchRecords = batchRecords;
+        }
+
+        entry = "snapshotBatchBytes";
+        if (node[entry]) {
+            const long batchBytes = node[entry].as<long>();
+            if (batchBytes < 0) throw std::runtime_error("Input: snapshotBatchBytes must be non-negative");
+            snapshotConfig_.batchBytes = batchBytes;
+        }
+
+        entry = "snapshotAsync";
+        if (node[entry]) snapshotConfig_.async = node[entry].as<bool>();
+
+        entry = "snapshotQueueDepth";
+        if (node[entry]) {
+            snapshotConfig_.queueDepth = node[entry].as<int>();
+            if (snapshotConfig_.queueDepth < 1) throw std::runtime_error("Input: snapshotQueueDepth must be positive");
+        }
+
+        // in-situ error norms against a reference trajectory, off unless a reference is given
+        entry = "errorReference";
+        if (node[entry]) {
+            errorConfig_.enabled = true;
+            errorConfig_.reference = node[entry].as<std::string>();
+            errorConfig_.sampleFreq = stateSamplingFreq_;
+            errorConfig_.referenceSampleFreq = stateSamplingFreq_;
+
+            entry = "errorSamplingFreq";
+            if (node[entry]) errorConfig_.sampleFreq = node[entry].as<int>();
+            if (errorConfig_.sampleFreq < 1) throw std::runtime_error("Input: errorSamplingFreq must be positive");
+
+            entry = "errorReferenceSamplingFreq";
+            if (node[entry]) errorConfig_.referenceSampleFreq = node[entry].as<int>();
+            if (errorConfig_.referenceSampleFreq < 1) throw std::runtime_error("Input: errorReferenceSamplingFreq must be positive");
+        }
+
+        // probed cells, by gid list or bounding box
+        auto probeNode = node["probes"];
+        if (probeNode) {
+            probeConfig_.enabled = true;
+
+            entry = "sampleFreq";
+            if (probeNode[entry]) probeConfig_.sampleFreq = probeNode[entry].as<int>();
+            if (probeConfig_.sampleFreq < 1) throw std::runtime_error("Input probes: sampleFreq must be positive");
+
+            entry = "gids";
+            if (probeNode[entry]) probeConfig_.gids = probeNode[entry].as<std::vector<int>>();
+
+            entry = "box";
+            if (probeNode[entry]) {
+                probeConfig_.box = probeNode[entry].as<std::vector<double>>();
+                if (probeConfig_.box.size() != 4) throw std::runtime_error("Input probes: box must be [xmin, xmax, ymin, ymax]");
+            }
+            if (probeConfig_.gids.empty() == probeConfig_.box.empty()) {
+                throw std::runtime_error("Input probes: set exactly one of gids or box");
+            }
+
+            entry = "bufferRecords";
+            if (probeNode[entry]) probeConfig_.bufferRecords = probeNode[entry].as<int>();
+            if (probeConfig_.bufferRecords < 1) throw std::runtime_error("Input probes: bufferRecords must be positive");
+
+            entry = "file";
+            if (probeNode[entry]) probeConfig_.file = probeNode[entry].as<std::string>();
+        }
+
+        // latest sampled states in shared memory, for monitoring a running job
+        auto liveNode = node["live"];
+        if (liveNode) {
+            liveConfig_.enabled = true;
+
+            entry = "name";
+            if (liveNode[entry]) liveConfig_.name = liveNode[entry].as<std::string>();
+            if (liveConfig_.name.empty() || (liveConfig_.name[0] != '/') ||
+                (liveConfig_.name.find('/', 1) != std::string::npos)) {
+                throw std::runtime_error("Input live: name must look like /name");
+            }
+
+            entry = "sampleFreq";
+            if (liveNode[entry]) liveConfig_.sampleFreq = liveNode[entry].as<int>();
+            if (liveConfig_.sampleFreq < 1) throw std::runtime_error("Input live: sampleFreq must be positive");
+
+            entry = "slots";
+            if (liveNode[entry]) liveConfig_.slots = liveNode[entry].as<int>();
+            if (liveConfig_.slots < 1) throw std::runtime_error("Input live: slots must be positive");
+        }
+
+        // time loop progress on stdout, optionally mirrored to a status file; see progress.hpp
+        auto progressNode = node["progress"];
+        if (progressNode) {
+            entry = "interval";
+            if (progressNode[entry]) progressConfig_.interval = progressNode[entry].as<double>();
+            if (progressConfig_.interval < 0.0) throw std::runtime_error("Input progress: interval must be non-negative");
+
+            entry = "statusFile";
+            if (progressNode[entry]) progressConfig_.statusFile = progressNode[entry].as<std::string>();
+        }
+
+        // checkpoints, written every checkpointInterval seconds of wall time and on SIGTERM/SIGUSR1
+        entry = "checkpointFile";
+        if (node[entry]) {
+            checkpointConfig_.enabled = true;
+            checkpointConfig_.file = node[entry].as<std::string>();
+        }
+
+        entry = "checkpointInterval";
+        if (node[entry]) {
+            checkpointConfig_.enabled = true;
+            checkpointConfig_.interval = node[entry].as<double>();
+            if (checkpointConfig_.interval < 0.0) throw std::runtime_error("Input: checkpointInterval must be non-negative");
+        }
+
+        entry = "restartFile";
+        if (node[entry]) checkpointConfig_.restartFile = node[entry].as<std::string>();
+
+        // JSON summary of the run's nested timers, see timers.hpp
+        entry = "timersFile";
+        if (node[entry]) timersFile_ = node[entry].as<std::string>();
+
+        // Chrome trace of what each thread does, see trace.hpp
+        entry = "traceFile";
+        if (node[entry]) traceFile_ = node[entry].as<std::string>();
+
+        // hardware counters per phase, see perf_counters.hpp
+        entry = "perfCountersFile";
+        if (node[entry]) perfCountersFile_ = node[entry].as<std::string>();
+
+        // heap allocations and resident memory per phase and step, see memory.hpp
+        entry = "memoryFile";
+        if (node[entry]) memoryFile_ = node[entry].as<std::string>();
+
     }
 };
 
@@ -133,6 +365,8 @@ protected:
     int numSteps_;
     pressiodemoapps::InviscidFluxReconstruction fluxOrder_ = {};
     std::string icFile_ = "";
+    PodConfig podConfig_ = {};
+    std::string solverTelemetryFile_ = "";
 
 public:
     ParserMono() = delete;
@@ -145,6 +379,8 @@ public:
     auto numSteps()     const { return numSteps_; }
     auto fluxOrder()    const { return fluxOrder_; }
     auto icFile()       const { return icFile_; }
+    auto podConfig()    const { return podConfig_; }
+    auto solverTelemetryFile() const { return solverTelemetryFile_; }
 
 private:
     void parseImpl(YAML::Node & node)
@@ -172,6 +408,47 @@ private:
         if (node[entry]) {
             icFile_ = node[entry].as<std::string>();
         }
+
+        // in-situ POD basis, FOM runs only. The SVD is not checkpointed, so a restarted run
+        // would write a basis of the steps after the restart only
+        auto podNode = node["pod"];
+        if (podNode) {
+            podConfig_.enabled = true;
+            if (node["restartFile"]) {
+                throw std::runtime_error("Input pod: cannot be combined with restartFile, the basis would miss the steps before the restart");
+            }
+
+            entry = "sampleFreq";
+            if (podNode[entry]) podConfig_.sampleFreq = podNode[entry].as<int>();
+            if (podConfig_.sampleFreq < 1) throw std::runtime_error("Input pod: sampleFreq must be positive");
+
+            entry = "center";
+            if (podNode[entry]) podConfig_.center = string_to_pod_center(podNode[entry].as<std::string>());
+
+            entry = "energy";
+            if (podNode[entry]) podConfig_.energy = podNode[entry].as<double>();
+            if (!((podConfig_.energy > 0.0) && (podConfig_.energy <= 1.0))) {
+                throw std::runtime_error("Input pod: energy must be in (0, 1]");
+            }
+
+            entry = "maxModes";
+            if (podNode[entry]) podConfig_.maxModes = podNode[entry].as<int>();
+            if (podConfig_.maxModes < 0) throw std::runtime_error("Input pod: maxModes must be non-negative");
+
+            entry = "batchSize";
+            if (podNode[entry]) podConfig_.batchSize = podNode[entry].as<int>();
+            if (podConfig_.batchSize < 1) throw std::runtime_error("Input pod: batchSize must be positive");
+
+            entry = "basisFile";
+            if (podNode[entry]) podConfig_.basisFile = podNode[entry].as<std::string>();
+
+            entry = "centerFile";
+            if (podNode[entry]) podConfig_.centerFile = podNode[entry].as<std::string>();
+        }
+
+        // per-step nonlinear/linear solver statistics, see solver_telemetry.hpp
+        entry = "solverTelemetryFile";
+        if (node[entry]) solverTelemetryFile_ = node[entry].as<std::string>();
     }
 
 };
@@ -312,6 +589,8 @@ protected:
     ScalarType relTol_ = 1e-11;
     ScalarType absTol_ = 1e-11;
     int convStepMax_ = 10;
+    std::string subiterationFile_ = "";
+    std::string barrierFile_ = "";
 
 public:
     ParserDecomp() = delete;
@@ -339,6 +618,8 @@ public:
     auto relTol()           const { return relTol_; }
     auto absTol()           const { return absTol_; }
     auto convStepMax()      const { return convStepMax_; }
+    auto subiterationFile() const { return subiterationFile_; }
+    auto barrierFile()      const { return barrierFile_; }
 
 private:
     void parseImpl(YAML::Node & parentNode) {
@@ -385,6 +666,18 @@ private:
             if (decompNode[entry]) absTol_ = decompNode[entry].as<ScalarType>();
             entry = "convStepMax";
             if (decompNode[entry]) convStepMax_ = decompNode[entry].as<int>();
+            if (convStepMax_ < 1) throw std::runtime_error("Input decomp: convStepMax must be positive");
+
+            // subiterations and subdomain updates per outer step, see subiterations.hpp
+            entry = "subiterationFile";
+            if (decompNode[entry]) subiterationFile_ = decompNode[entry].as<std::string>();
+
+            // busy vs barrier wait time per thread and load imbalance per step, see barriers.hpp
+            entry = "barrierFile";
+            if (decompNode[entry]) barrierFile_ = decompNode[entry].as<std::string>();
+#if !defined SCHWARZ_ENABLE_OMP
+            if (!barrierFile_.empty()) throw std::runtime_error("Input decomp: barrierFile needs the OpenMP runner");
+#endif
 
             entry = "odeScheme";
             if (decompNode[entry]) {
@@ -524,6 +817,11 @@ private:
             throw std::runtime_error("Input: cannot set rom and decomp fields in same input file");
         }
 
+        // in-situ POD is only wired into the monolithic FOM
+        if ((this->podConfig_.enabled) && (this->isRom_ || this->isDecomp_)) {
+            throw std::runtime_error("Input: pod is only supported for monolithic FOM runs");
+        }
+
         // make sure time step and scheme were set for monolithic simulation
         // doesn't throw error in class construction b/c not needed for decomposed solution
         if (!this->isDecomp_) {
@@ -561,6 +859,7 @@ public:
     }
 
     auto probId()           const{ return probId_; }
+    auto numDofPerCell()    const{ return 3; }
 
 private:
     void parseImpl(YAML::Node & node) {
@@ -634,6 +933,7 @@ public:
     }
 
     auto probId() const{ return probId_; }
+    auto numDofPerCell() const{ return 4; }
 
 private:
     void parseImpl(YAML::Node & node) {
@@ -703,6 +1003,7 @@ public:
     }
 
     auto probId()           const{ return probId_; }
+    auto numDofPerCell()    const{ return 2; }
 
 private:
     void parseImpl(YAML::Node & node) {
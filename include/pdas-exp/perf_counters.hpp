@@ -0,0 +1,309 @@
+#ifndef PDAS_EXPERIMENTS_PERF_COUNTERS_HPP_
+#define PDAS_EXPERIMENTS_PERF_COUNTERS_HPP_
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+    Hardware counters per thread and phase, through perf_event_open (Linux only):
+
+        PerfScope scope("solve");
+
+    Each thread opens its own counters the first time it enters a phase and counts only itself,
+    user space only, so perf_event_paranoid <= 2 suffices. A counter that cannot be opened
+    (no PMU in a VM or container, seccomp, paranoid 3, not Linux) is reported as null and the
+    run goes on; disabled (the default) a scope is one relaxed atomic load.
+    With perfCountersFile set in the input, the totals are written as JSON when the runner exits:
+
+    {"version": 1, "events": ["cycles", "instructions", "llcMisses", "branchMisses"], "threads": [
+        {"thread": 0, "phases": [{"name": "solve", "calls": 10, "cycles": 123, ..., "ipc": 1.5,
+                                  "llcMissesPerKiloInstr": 0.2, "branchMissesPerKiloInstr": 1.1}, ...]}, ...]}
+
+    The counters of a thread form one perf group, read in one call and scaled for multiplexing
+    (time enabled / time running) by the same ratio, so ipc compares counts over the same intervals.
+*/
+
+constexpr std::size_t perf_num_events = 4;
+constexpr const char * perf_event_names[perf_num_events] = {"cycles", "instructions", "llcMisses", "branchMisses"};
+
+using perf_values_t = std::array<double, perf_num_events>;
+
+// one thread's counters, opened as one group led by the first event so they are scheduled together
+// and scaled by the same multiplexing ratio; a negative descriptor is an unavailable counter.
+// Without a leader the others are opened on their own and scaled separately.
+class PerfCounterSet
+{
+public:
+    PerfCounterSet()
+    {
+        fds_.fill(-1);
+        groupSlots_.fill(-1);
+#if defined(__linux__)
+        const std::uint64_t configs[perf_num_events] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[eventIdx];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            if ((eventIdx == 0) || (leaderFd_ >= 0)) attr.read_format |= PERF_FORMAT_GROUP;
+            // calling thread, any cpu
+            const long fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, leaderFd_, 0);
+            if (fd < 0) {
+                error_ += (error_.empty() ? "" : ", ") + std::string(perf_event_names[eventIdx]) + ": " + std::strerror(errno);
+                continue;
+            }
+            fds_[eventIdx] = static_cast<int>(fd);
+            if (eventIdx == 0) leaderFd_ = fds_[eventIdx];
+            if (leaderFd_ >= 0) groupSlots_[eventIdx] = groupSize_++;
+        }
+#else
+        error_ = "perf_event_open needs Linux";
+#endif
+    }
+
+    PerfCounterSet(const PerfCounterSet &) = delete;
+    PerfCounterSet & operator=(const PerfCounterSet &) = delete;
+
+    ~PerfCounterSet()
+    {
+#if defined(__linux__)
+        for (const auto fd : fds_) {
+            if (fd >= 0) ::close(fd);
+        }
+#endif
+    }
+
+    bool available(std::size_t eventIdx) const { return fds_[eventIdx] >= 0; }
+    const std::string & error()          const { return error_; }
+
+    // running totals; unavailable counters read 0
+    perf_values_t read() const
+    {
+        perf_values_t values = {};
+#if defined(__linux__)
+        if (leaderFd_ >= 0) {
+            // nr, time enabled, time running, one value per member in the order they were opened
+            std::uint64_t buf[3 + perf_num_events];
+            const auto expected = static_cast<ssize_t>((3 + groupSize_) * sizeof(std::uint64_t));
+            if ((::read(leaderFd_, buf, sizeof(buf)) == expected) && (buf[2] != 0)) {
+                const double scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+                for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+                    if (groupSlots_[eventIdx] >= 0) values[eventIdx] = static_cast<double>(buf[3 + groupSlots_[eventIdx]]) * scale;
+                }
+            }
+            return values;
+        }
+        for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+            if (fds_[eventIdx] < 0) continue;
+            std::uint64_t buf[3];  // value, time enabled, time running
+            if (::read(fds_[eventIdx], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)) || (buf[2] == 0)) continue;
+            values[eventIdx] = static_cast<double>(buf[0]) * (static_cast<double>(buf[1]) / static_cast<double>(buf[2]));
+        }
+#endif
+        return values;
+    }
+
+private:
+    std::array<int, perf_num_events> fds_;
+    std::array<int, perf_num_events> groupSlots_;   // position in the group read, -1: not in the group
+    int leaderFd_ = -1;
+    int groupSize_ = 0;
+    std::string error_;
+};
+
+struct PerfPhase
+{
+    std::string name;
+    std::uint64_t calls = 0;
+    perf_values_t totals = {};
+};
+
+struct PerfThreadData
+{
+    PerfCounterSet counters;
+    std::deque<PerfPhase> phases;   // stable references for nested scopes
+    int paused = 0;                 // scopes opened while a PerfPause lives count nothing
+
+    PerfPhase & phase(const char * name)
+    {
+        for (auto & entry : phases) {
+            if (entry.name == name) return entry;
+        }
+        phases.push_back(PerfPhase{name});
+        return phases.back();
+    }
+};
+
+class PerfCounterRegistry
+{
+public:
+    static PerfCounterRegistry & instance()
+    {
+        static PerfCounterRegistry registry;
+        return registry;
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void enable(const std::string & f0)
+    {
+        fileName_ = f0;
+        enabled_.store(true, std::memory_order_relaxed);
+        // the main thread's counters, to report availability up front
+        const auto & counters = thread().counters;
+        if (!counters.error().empty()) {
+            std::cout << "Hardware counters unavailable, reported as null: " << counters.error() << std::endl;
+        }
+    }
+
+    // the calling thread's counters and totals, opened on first use; kept until exit
+    PerfThreadData & thread()
+    {
+        thread_local PerfThreadData * data = nullptr;
+        if (data == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads_.emplace_back(new PerfThreadData);
+            data = threads_.back().get();
+        }
+        return *data;
+    }
+
+    // call with the worker threads idle, i.e. outside parallel regions
+    void write() const
+    {
+        if (!enabled()) return;
+        std::ofstream fout(fileName_);
+        if (!fout) throw std::runtime_error("Could not open " + fileName_);
+
+        fout << "{\"version\": 1, \"events\": [";
+        for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+            fout << (eventIdx ? ", " : "") << "\"" << perf_event_names[eventIdx] << "\"";
+        }
+        fout << "], \"threads\": [";
+        for (std::size_t threadIdx = 0; threadIdx < threads_.size(); ++threadIdx) {
+            const auto & data = *threads_[threadIdx];
+            fout << (threadIdx ? ",\n" : "\n") << "{\"thread\": " << threadIdx << ", \"phases\": [";
+            for (std::size_t phaseIdx = 0; phaseIdx < data.phases.size(); ++phaseIdx) {
+                const auto & phase = data.phases[phaseIdx];
+                fout << (phaseIdx ? ", " : "") << "{\"name\": \"" << phase.name << "\", \"calls\": " << phase.calls;
+                for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+                    fout << ", \"" << perf_event_names[eventIdx] << "\": ";
+                    write_value(fout, data.counters.available(eventIdx), phase.totals[eventIdx]);
+                }
+                // derived rates, null if either operand is missing
+                const bool haveInstr = data.counters.available(1) && (phase.totals[1] > 0.0);
+                fout << ", \"ipc\": ";
+                write_value(fout, haveInstr && data.counters.available(0) && (phase.totals[0] > 0.0),
+                    phase.totals[1] / phase.totals[0]);
+                fout << ", \"llcMissesPerKiloInstr\": ";
+                write_value(fout, haveInstr && data.counters.available(2), 1e3 * phase.totals[2] / phase.totals[1]);
+                fout << ", \"branchMissesPerKiloInstr\": ";
+                write_value(fout, haveInstr && data.counters.available(3), 1e3 * phase.totals[3] / phase.totals[1]);
+                fout << "}";
+            }
+            fout << "]}";
+        }
+        fout << "\n]}\n";
+    }
+
+private:
+    PerfCounterRegistry() = default;
+
+    static void write_value(std::ofstream & fout, bool valid, double value)
+    {
+        if (valid) fout << value;
+        else fout << "null";
+    }
+
+    std::atomic<bool> enabled_{false};
+    std::string fileName_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<PerfThreadData>> threads_;
+};
+
+// counts from construction to destruction (or stop()) into the calling thread's phase
+class PerfScope
+{
+public:
+    explicit PerfScope(const char * name)
+    {
+        auto & registry = PerfCounterRegistry::instance();
+        if (!registry.enabled()) return;
+        auto & data = registry.thread();
+        if (data.paused > 0) return;
+        data_ = &data;
+        phase_ = &data_->phase(name);
+        start_ = data_->counters.read();
+    }
+
+    PerfScope(const PerfScope &) = delete;
+    PerfScope & operator=(const PerfScope &) = delete;
+
+    ~PerfScope() { stop(); }
+
+    void stop()
+    {
+        if (data_ == nullptr) return;
+        const auto end = data_->counters.read();
+        for (std::size_t eventIdx = 0; eventIdx < perf_num_events; ++eventIdx) {
+            phase_->totals[eventIdx] += end[eventIdx] - start_[eventIdx];
+        }
+        phase_->calls += 1;
+        data_ = nullptr;
+    }
+
+private:
+    PerfThreadData * data_ = nullptr;
+    PerfPhase * phase_ = nullptr;
+    perf_values_t start_ = {};
+};
+
+// keeps the PerfScopes the calling thread opens from construction to destruction out of every phase,
+// e.g. for work replayed on restart; scopes already open go on counting
+class PerfPause
+{
+public:
+    PerfPause()
+    {
+        auto & registry = PerfCounterRegistry::instance();
+        if (!registry.enabled()) return;
+        data_ = &registry.thread();
+        data_->paused += 1;
+    }
+
+    PerfPause(const PerfPause &) = delete;
+    PerfPause & operator=(const PerfPause &) = delete;
+
+    ~PerfPause()
+    {
+        if (data_ != nullptr) data_->paused -= 1;
+    }
+
+private:
+    PerfThreadData * data_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef PDAS_EXPERIMENTS_PROBES_HPP_
+#define PDAS_EXPERIMENTS_PROBES_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Probe/region-of-interest output, the "probes" block of the input file
+struct ProbeConfig
+{
+    bool enabled = false;
+    int sampleFreq = 1;
+    std::vector<int> gids = {};         // cell ids of the (monolithic) mesh
+    std::vector<double> box = {};       // xmin, xmax, ymin, ymax; selects cells by centroid
+    int bufferRecords = 256;            // records held in memory between writes
+    std::string file = "probes.bin";
+};
+
+// cell centroids of a pressio-demoapps mesh directory, by gid
+struct ProbeMeshCells
+{
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+inline ProbeMeshCells read_probe_mesh_cells(const std::string & meshDir)
+{
+    const std::string coordsFile = meshDir + "/coordinates.dat";
+    std::ifstream fin(coordsFile);
+    if (!fin) throw std::runtime_error("Could not open " + coordsFile);
+
+    // each line: gid x y
+    ProbeMeshCells cells;
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream ss(line);
+        int gid;
+        double x, y;
+        if (!(ss >> gid >> x >> y)) continue;
+        if (gid != static_cast<int>(cells.x.size())) {
+            throw std::runtime_error(coordsFile + ": cell gids are not numbered consecutively");
+        }
+        cells.x.push_back(x);
+        cells.y.push_back(y);
+    }
+    return cells;
+}
+
+inline bool in_probe_box(const ProbeConfig & config, double x, double y)
+{
+    return (x >= config.box[0]) && (x <= config.box[1]) && (y >= config.box[2]) && (y <= config.box[3]);
+}
+
+// cells of a pressio-demoapps mesh directory selected by gid list or bounding box
+inline std::vector<int> select_probe_cells(const ProbeConfig & config, const std::string & meshDir)
+{
+    const auto mesh = read_probe_mesh_cells(meshDir);
+    const int numCells = static_cast<int>(mesh.x.size());
+
+    if (!config.box.empty()) {
+        std::vector<int> cells;
+        for (int gid = 0; gid < numCells; ++gid) {
+            if (in_probe_box(config, mesh.x[gid], mesh.y[gid])) cells.push_back(gid);
+        }
+        return cells;
+    }
+    for (const auto gid : config.gids) {
+        if ((gid < 0) || (gid >= numCells)) {
+            throw std::runtime_error("Probe gid " + std::to_string(gid) + " is not in " + meshDir);
+        }
+    }
+    return config.gids;
+}
+
+// smallest spacing between distinct centroid coordinates, the cell width of a uniform mesh
+inline double probe_grid_spacing(std::vector<double> coords)
+{
+    std::sort(coords.begin(), coords.end());
+    const double tol = 1e-8 * std::max(coords.back() - coords.front(), 1.0);
+    double spacing = 0.0;
+    for (std::size_t i = 1; i < coords.size(); ++i) {
+        const double gap = coords[i] - coords[i - 1];
+        if ((gap > tol) && ((spacing == 0.0) || (gap < spacing))) spacing = gap;
+    }
+    return spacing;
+}
+
+/*
+    Probed cells of a decomposed mesh as (domain, local gid), with gids of the monolithic mesh.
+    Subdomain cells are placed on the monolithic grid by their centroids, whose gids number it
+    x-fastest from the lower left cell as pressio-demoapps does. A cell in the overlap of several
+    subdomains is probed once, in the lowest-numbered subdomain holding it. Cells are grouped by
+    domain, in gid list order or by local gid for a box.
+*/
+inline std::vector<std::pair<int, int>> select_probe_cells(const ProbeConfig & config,
+                                                           const std::vector<std::string> & meshDirs)
+{
+    std::vector<std::pair<int, int>> cells;
+    if (meshDirs.size() == 1) {
+        for (const auto gid : select_probe_cells(config, meshDirs[0])) cells.emplace_back(0, gid);
+        return cells;
+    }
+
+    std::vector<ProbeMeshCells> meshes;
+    std::vector<double> allX, allY;
+    for (const auto & meshDir : meshDirs) {
+        meshes.push_back(read_probe_mesh_cells(meshDir));
+        allX.insert(allX.end(), meshes.back().x.begin(), meshes.back().x.end());
+        allY.insert(allY.end(), meshes.back().y.begin(), meshes.back().y.end());
+    }
+    if (allX.empty()) return cells;
+    const double dx = probe_grid_spacing(allX);
+    const double dy = probe_grid_spacing(allY);
+    const double xmin = *std::min_element(allX.begin(), allX.end());
+    const double ymin = *std::min_element(allY.begin(), allY.end());
+    const long nx = (dx > 0.0) ? std::lround((*std::max_element(allX.begin(), allX.end()) - xmin) / dx) + 1 : 1;
+    const long ny = (dy > 0.0) ? std::lround((*std::max_element(allY.begin(), allY.end()) - ymin) / dy) + 1 : 1;
+
+    auto monolithic_gid = [&](const ProbeMeshCells & mesh, std::size_t gid) {
+        const long i = (dx > 0.0) ? std::lround((mesh.x[gid] - xmin) / dx) : 0;
+        const long j = (dy > 0.0) ? std::lround((mesh.y[gid] - ymin) / dy) : 0;
+        return static_cast<std::size_t>(j * nx + i);
+    };
+
+    // subdomain cell holding each monolithic cell, the first one to claim it
+    std::vector<std::pair<int, int>> owner(static_cast<std::size_t>(nx * ny), {-1, -1});
+    for (std::size_t domIdx = 0; domIdx < meshes.size(); ++domIdx) {
+        const auto & mesh = meshes[domIdx];
+        for (std::size_t gid = 0; gid < mesh.x.size(); ++gid) {
+            auto & cell = owner[monolithic_gid(mesh, gid)];
+            if (cell.first < 0) cell = {static_cast<int>(domIdx), static_cast<int>(gid)};
+        }
+    }
+
+    for (std::size_t domIdx = 0; domIdx < meshes.size(); ++domIdx) {
+        if (!config.box.empty()) {
+            const auto & mesh = meshes[domIdx];
+            for (std::size_t gid = 0; gid < mesh.x.size(); ++gid) {
+                const auto & cell = owner[monolithic_gid(mesh, gid)];
+                if ((cell.first == static_cast<int>(domIdx)) && (cell.second == static_cast<int>(gid))
+                    && in_probe_box(config, mesh.x[gid], mesh.y[gid])) {
+                    cells.push_back(cell);
+                }
+            }
+            continue;
+        }
+        for (const auto gid : config.gids) {
+            if ((gid < 0) || (gid >= nx * ny) || (owner[gid].first < 0)) {
+                throw std::runtime_error("Probe gid " + std::to_string(gid) + " is not a cell of the decomposed mesh");
+            }
+            if (owner[gid].first == static_cast<int>(domIdx)) cells.push_back(owner[gid]);
+        }
+    }
+    return cells;
+}
+
+/*
+    Buffered probe file:
+    header: std::uint64_t numCells, std::uint64_t nvars, (std::int64_t domIdx, std::int64_t gid) x numCells
+            gid numbers the cell in its domain's mesh, in decomposed runs a subdomain mesh
+    record: std::int64_t step, double time, double value x (numCells * nvars), cell-interleaved
+*/
+class ProbeFileWriter
+{
+public:
+    ProbeFileWriter() = default;
+
+    // append continues the file of a restarted run, which already has the header
+    ProbeFileWriter(const std::string & f0, int nvars,
+                    const std::vector<std::pair<int, int>> & cells, int bufferRecords, bool append = false)
+        : fileName_(f0), file_(f0, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc)),
+        recordBytes_(sizeof(std::int64_t) + sizeof(double) + cells.size() * nvars * sizeof(double)),
+        bufferBytes_(recordBytes_ * (bufferRecords > 0 ? bufferRecords : 1))
+    {
+        if (!file_) throw std::runtime_error("Could not open " + f0);
+        buffer_.reserve(bufferBytes_);
+
+        const std::uint64_t header[2] = {cells.size(), static_cast<std::uint64_t>(nvars)};
+        if (append) {
+            std::ifstream fin(f0, std::ios::in | std::ios::binary);
+            std::uint64_t stored[2] = {};
+            fin.read(reinterpret_cast<char*>(stored), sizeof(stored));
+            if (!fin || (stored[0] != header[0]) || (stored[1] != header[1])) {
+                throw std::runtime_error("ProbeFileWriter: " + f0 + " does not hold the probed cells of this run");
+            }
+            fin.seekg(0, std::ios::end);
+            size_ = static_cast<std::uint64_t>(fin.tellg());
+            return;
+        }
+        file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto & cell : cells) {
+            const std::int64_t ids[2] = {cell.first, cell.second};
+            file_.write(reinterpret_cast<const char*>(ids), sizeof(ids));
+        }
+        size_ = sizeof(header) + cells.size() * 2 * sizeof(std::int64_t);
+    }
+
+    ProbeFileWriter(ProbeFileWriter &&) = default;
+    ProbeFileWriter & operator=(ProbeFileWriter &&) = default;
+
+    ~ProbeFileWriter()
+    {
+        if (!file_.is_open()) return;
+        try { flush(); } catch (...) {}
+    }
+
+    void write(std::int64_t step, double time, const std::vector<double> & values)
+    {
+        const auto pos = buffer_.size();
+        buffer_.resize(pos + recordBytes_);
+        std::memcpy(buffer_.data() + pos, &step, sizeof(std::int64_t));
+        std::memcpy(buffer_.data() + pos + sizeof(std::int64_t), &time, sizeof(double));
+        std::memcpy(buffer_.data() + pos + sizeof(std::int64_t) + sizeof(double),
+            values.data(), values.size() * sizeof(double));
+        if (buffer_.size() >= bufferBytes_) flush();
+    }
+
+    void flush()
+    {
+        if (!buffer_.empty()) {
+            file_.write(buffer_.data(), buffer_.size());
+            size_ += buffer_.size();
+            buffer_.clear();
+        }
+        file_.flush();
+        if (!file_) throw std::runtime_error("Failed writing to " + fileName_);
+    }
+
+    const std::string & fileName() const { return fileName_; }
+
+    // bytes on disk, as of the last flush()
+    std::uint64_t size() const { return size_; }
+
+private:
+    std::string fileName_;
+    std::ofstream file_;
+    std::uint64_t size_ = 0;
+    std::size_t recordBytes_ = 0;
+    std::size_t bufferBytes_ = 0;
+    std::vector<char> buffer_;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef PDAS_EXPERIMENTS_PROGRESS_HPP_
+#define PDAS_EXPERIMENTS_PROGRESS_HPP_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+struct ProgressConfig
+{
+    double interval = 5.0;          // wall-clock seconds between reports, 0 reports every step
+    std::string statusFile = "";    // JSON mirror of the latest report, replaced atomically
+};
+
+/*
+    Progress of the time loop, printed at most once per interval:
+
+        Step 120/1000, t = 1.2, 12.3 steps/s, 3.10 subiterations/step, ETA 1m12s
+
+    steps/s and subiterations/step are averaged since the previous report, the ETA uses the rate
+    since the loop started. With statusFile set, each report is also written as
+
+    {"state": "running", "step": 120, "numSteps": 1000, "time": 1.2, "stepsPerSecond": 12.3,
+     "subitersPerStep": 3.1, "elapsedSeconds": 9.8, "etaSeconds": 72.0}
+
+    to a temporary file renamed over statusFile, so readers never see a partial file.
+    Reports are formatted in fixed buffers, so they do not show up as allocating steps in memoryFile.
+    state becomes "finished" or "stopped" (e.g. after a checkpoint on SIGTERM) at the end of the run.
+*/
+class ProgressReporter
+{
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    // subiterations: report Schwarz subiterations per step, for decomposed runs
+    ProgressReporter(const ProgressConfig & config, std::int64_t startStep, std::int64_t numSteps, bool subiterations)
+        : config_(config), startStep_(startStep), numSteps_(numSteps), subiterations_(subiterations),
+        lastStep_(startStep), reportStep_(startStep), tmpFile_(config.statusFile + ".tmp")
+    {
+        if (config_.interval < 0.0) throw std::runtime_error("ProgressReporter: interval must be non-negative");
+        start_ = clock_t::now();
+        lastReport_ = start_;
+    }
+
+    // after each step, from one thread; a clock read unless a report is due
+    void operator()(std::int64_t step, double time, int numSubiters = 1)
+    {
+        lastStep_ = step;
+        lastTime_ = time;
+        subiters_ += numSubiters;
+        const auto now = clock_t::now();
+        // the first step is reported right away, to show the run is going
+        const bool first = (step == startStep_ + 1);
+        if (!first && (std::chrono::duration<double>(now - lastReport_).count() < config_.interval)) return;
+        report(now, "running", true);
+    }
+
+    // once the loop is left, whether it ran to the end or stopped early; the last step is printed unless it just was
+    void finish()
+    {
+        report(clock_t::now(), (lastStep_ >= numSteps_) ? "finished" : "stopped", lastStep_ != reportStep_);
+    }
+
+private:
+    void report(clock_t::time_point now, const char * state, bool print)
+    {
+        const double sinceReport = std::chrono::duration<double>(now - lastReport_).count();
+        const double elapsed = std::chrono::duration<double>(now - start_).count();
+        // rates of the previous report stand if no step was taken since
+        const auto steps = lastStep_ - reportStep_;
+        if ((steps > 0) && (sinceReport > 0.0)) {
+            rate_ = steps / sinceReport;
+            subitersPerStep_ = static_cast<double>(subiters_) / steps;
+        }
+        const double avgRate = (elapsed > 0.0) ? (lastStep_ - startStep_) / elapsed : 0.0;
+        const double eta = (avgRate > 0.0) ? (numSteps_ - lastStep_) / avgRate : 0.0;
+
+        if (print) {
+            char etaStr[32];
+            format_seconds(eta, etaStr, sizeof(etaStr));
+            std::cout << "Step " << lastStep_ << "/" << numSteps_ << ", t = " << lastTime_
+                << ", " << rate_ << " steps/s";
+            if (subiterations_) std::cout << ", " << subitersPerStep_ << " subiterations/step";
+            std::cout << ", ETA " << etaStr << std::endl;
+        }
+
+        if (!config_.statusFile.empty()) {
+            write_status(state, elapsed, eta);
+        }
+
+        lastReport_ = now;
+        reportStep_ = lastStep_;
+        subiters_ = 0;
+    }
+
+    // subitersPerStep is null in monolithic runs
+    void write_status(const char * state, double elapsed, double eta) const
+    {
+        char subiters[32] = "null";
+        if (subiterations_) std::snprintf(subiters, sizeof(subiters), "%.6g", subitersPerStep_);
+        char buf[512];
+        const int len = std::snprintf(buf, sizeof(buf), "{\"state\": \"%s\", \"step\": %lld, \"numSteps\": %lld, "
+            "\"time\": %.9g, \"stepsPerSecond\": %.6g, \"subitersPerStep\": %s, \"elapsedSeconds\": %.6g, "
+            "\"etaSeconds\": %.6g}\n", state, static_cast<long long>(lastStep_), static_cast<long long>(numSteps_),
+            lastTime_, rate_, subiters, elapsed, eta);
+        const int fd = ::open(tmpFile_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Could not open " + tmpFile_);
+        const bool written = (::write(fd, buf, len) == len);
+        ::close(fd);
+        if (!written || (std::rename(tmpFile_.c_str(), config_.statusFile.c_str()) != 0)) {
+            throw std::runtime_error("Could not replace " + config_.statusFile);
+        }
+    }
+
+    // e.g. 1h02m03s, 4m05s, 6s
+    static void format_seconds(double seconds, char * out, std::size_t size)
+    {
+        const long long total = std::llround(seconds);
+        const long long hours = total / 3600;
+        const long long minutes = (total % 3600) / 60;
+        const long long secs = total % 60;
+        if (hours > 0) std::snprintf(out, size, "%lldh%02lldm%02llds", hours, minutes, secs);
+        else if (minutes > 0) std::snprintf(out, size, "%lldm%02llds", minutes, secs);
+        else std::snprintf(out, size, "%llds", secs);
+    }
+
+    ProgressConfig config_;
+    std::int64_t startStep_ = 0;
+    std::int64_t numSteps_ = 0;
+    bool subiterations_ = false;
+    std::int64_t lastStep_ = 0;
+    std::int64_t reportStep_ = 0;
+    double lastTime_ = 0.0;
+    std::int64_t subiters_ = 0;
+    double rate_ = 0.0;
+    double subitersPerStep_ = 0.0;
+    clock_t::time_point start_;
+    clock_t::time_point lastReport_;
+    std::string tmpFile_;
+};
+
+#endif
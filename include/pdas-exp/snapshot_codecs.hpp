@@ -0,0 +1,586 @@
+#ifndef PDAS_EXPERIMENTS_SNAPSHOT_CODECS_HPP_
+#define PDAS_EXPERIMENTS_SNAPSHOT_CODECS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Snapshot block codecs
+
+    Each stored block (one per subdomain) gets its own codec instance, since the
+    temporal codecs keep the previously stored sample around. Records flagged as
+    keyframes never reference earlier records.
+*/
+
+enum class SnapshotCodecType : std::uint32_t { None = 0, Lossless = 1, Lossy = 2 };
+
+inline SnapshotCodecType string_to_snapshot_codec(const std::string & strIn)
+{
+    if      (strIn == "none")     { return SnapshotCodecType::None; }
+    else if (strIn == "lossless") { return SnapshotCodecType::Lossless; }
+    else if (strIn == "lossy")    { return SnapshotCodecType::Lossy; }
+    else {
+        throw std::runtime_error("string_to_snapshot_codec: Invalid snapshotCodec " + strIn);
+    }
+}
+
+// absolute, or relative to each variable's value range within the snapshot
+enum class ErrorBoundMode { Absolute, Relative };
+
+inline ErrorBoundMode string_to_error_bound_mode(const std::string & strIn)
+{
+    if      (strIn == "abs") { return ErrorBoundMode::Absolute; }
+    else if (strIn == "rel") { return ErrorBoundMode::Relative; }
+    else {
+        throw std::runtime_error("string_to_error_bound_mode: Invalid snapshotErrorBoundMode " + strIn);
+    }
+}
+
+namespace snapcodec {
+
+template<class T>
+void put(std::vector<char> & out, const T & val)
+{
+    const auto pos = out.size();
+    out.resize(pos + sizeof(T));
+    std::memcpy(out.data() + pos, &val, sizeof(T));
+}
+
+template<class T>
+T get(const char * & in, const char * end)
+{
+    if (in + sizeof(T) > end) throw std::runtime_error("snapshot codec: truncated block");
+    T val;
+    std::memcpy(&val, in, sizeof(T));
+    in += sizeof(T);
+    return val;
+}
+
+/*
+    Order-0 byte-wise rANS (after F. Giesen's rans_byte)
+*/
+
+constexpr std::uint32_t probBits  = 14;
+constexpr std::uint32_t probScale = 1u << probBits;
+constexpr std::uint32_t ransLow   = 1u << 23;
+
+// counts -> frequencies summing to probScale, every present symbol keeps at least 1
+inline void normalize_freqs(const std::array<std::uint64_t, 256> & counts, std::uint64_t total,
+                            std::array<std::uint32_t, 256> & freqs)
+{
+    std::int64_t sum = 0;
+    for (int sym = 0; sym < 256; ++sym) {
+        if (counts[sym] == 0) {
+            freqs[sym] = 0;
+            continue;
+        }
+        freqs[sym] = std::max<std::uint32_t>(1, static_cast<std::uint32_t>((counts[sym] * probScale) / total));
+        sum += freqs[sym];
+    }
+
+    std::int64_t diff = static_cast<std::int64_t>(probScale) - sum;
+    while (diff != 0) {
+        const auto maxIt = std::max_element(freqs.begin(), freqs.end());
+        if (diff > 0) {
+            *maxIt += static_cast<std::uint32_t>(diff);
+            diff = 0;
+        }
+        else {
+            const auto take = std::min<std::int64_t>(-diff, *maxIt - 1);
+            *maxIt -= static_cast<std::uint32_t>(take);
+            diff += take;
+        }
+    }
+}
+
+// [uint16 numSymbols][(uint8 symbol, uint16 freq) x numSymbols][uint32 nbytes][rANS stream]
+inline void rans_encode(const std::uint8_t * in, std::size_t n, std::vector<char> & out)
+{
+    std::array<std::uint64_t, 256> counts = {};
+    for (std::size_t i = 0; i < n; ++i) ++counts[in[i]];
+    std::array<std::uint32_t, 256> freqs;
+    normalize_freqs(counts, n, freqs);
+
+    std::array<std::uint32_t, 256> cums;
+    std::uint32_t cum = 0;
+    std::uint16_t numSymbols = 0;
+    for (int sym = 0; sym < 256; ++sym) {
+        cums[sym] = cum;
+        cum += freqs[sym];
+        if (freqs[sym] > 0) ++numSymbols;
+    }
+
+    put(out, numSymbols);
+    for (int sym = 0; sym < 256; ++sym) {
+        if (freqs[sym] == 0) continue;
+        put(out, static_cast<std::uint8_t>(sym));
+        put(out, static_cast<std::uint16_t>(freqs[sym]));
+    }
+
+    // the encoder runs backwards, at most two bytes per symbol plus the final state
+    std::vector<std::uint8_t> stream(2 * n + 8);
+    std::uint8_t * ptr = stream.data() + stream.size();
+    std::uint32_t x = ransLow;
+    for (std::size_t i = n; i-- > 0;) {
+        const std::uint32_t freq = freqs[in[i]];
+        const std::uint32_t xMax = ((ransLow >> probBits) << 8) * freq;
+        while (x >= xMax) {
+            *--ptr = static_cast<std::uint8_t>(x & 0xff);
+            x >>= 8;
+        }
+        x = ((x / freq) << probBits) + (x % freq) + cums[in[i]];
+    }
+    for (int byteIdx = 0; byteIdx < 4; ++byteIdx) {
+        *--ptr = static_cast<std::uint8_t>((x >> (8 * byteIdx)) & 0xff);
+    }
+
+    const auto nbytes = static_cast<std::uint32_t>(stream.data() + stream.size() - ptr);
+    put(out, nbytes);
+    const auto pos = out.size();
+    out.resize(pos + nbytes);
+    std::memcpy(out.data() + pos, ptr, nbytes);
+}
+
+inline void rans_decode(const char * & in, const char * end, std::uint8_t * out, std::size_t n)
+{
+    const auto numSymbols = get<std::uint16_t>(in, end);
+    std::array<std::uint32_t, 256> freqs = {};
+    std::array<std::uint32_t, 256> cums = {};
+    std::vector<std::uint8_t> slotToSym(probScale);
+    std::uint32_t cum = 0;
+    for (std::uint16_t symIdx = 0; symIdx < numSymbols; ++symIdx) {
+        const auto sym  = get<std::uint8_t>(in, end);
+        const auto freq = get<std::uint16_t>(in, end);
+        if (cum + freq > probScale) throw std::runtime_error("snapshot codec: corrupt frequency table");
+        freqs[sym] = freq;
+        cums[sym] = cum;
+        std::fill(slotToSym.begin() + cum, slotToSym.begin() + cum + freq, sym);
+        cum += freq;
+    }
+
+    const auto nbytes = get<std::uint32_t>(in, end);
+    if ((nbytes < 4) || (in + nbytes > end)) throw std::runtime_error("snapshot codec: truncated block");
+    const auto * ptr = reinterpret_cast<const std::uint8_t *>(in);
+    const auto * ptrEnd = ptr + nbytes;
+    std::uint32_t x = (std::uint32_t(ptr[0]) << 24) | (std::uint32_t(ptr[1]) << 16) |
+                      (std::uint32_t(ptr[2]) << 8)  |  std::uint32_t(ptr[3]);
+    ptr += 4;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::uint32_t slot = x & (probScale - 1);
+        const std::uint8_t sym = slotToSym[slot];
+        out[i] = sym;
+        x = freqs[sym] * (x >> probBits) + slot - cums[sym];
+        while ((x < ransLow) && (ptr < ptrEnd)) x = (x << 8) | *ptr++;
+    }
+    in += nbytes;
+}
+
+/*
+    Byte planes: each plane is stored raw, as a single repeated byte, or rANS coded,
+    whichever is smallest
+*/
+
+enum PlaneMode : std::uint8_t { PlaneRaw = 0, PlaneConst = 1, PlaneRans = 2 };
+
+inline void encode_plane(const std::uint8_t * in, std::size_t n, std::vector<char> & out)
+{
+    if (std::all_of(in, in + n, [&](std::uint8_t byte){ return byte == in[0]; })) {
+        put(out, static_cast<std::uint8_t>(PlaneConst));
+        put(out, in[0]);
+        return;
+    }
+
+    const auto pos = out.size();
+    put(out, static_cast<std::uint8_t>(PlaneRans));
+    rans_encode(in, n, out);
+    if (out.size() - pos > n + 1) {
+        out.resize(pos);
+        put(out, static_cast<std::uint8_t>(PlaneRaw));
+        out.resize(pos + 1 + n);
+        std::memcpy(out.data() + pos + 1, in, n);
+    }
+}
+
+inline void decode_plane(const char * & in, const char * end, std::uint8_t * out, std::size_t n)
+{
+    const auto mode = get<std::uint8_t>(in, end);
+    if (mode == PlaneConst) {
+        std::memset(out, get<std::uint8_t>(in, end), n);
+    }
+    else if (mode == PlaneRans) {
+        rans_decode(in, end, out, n);
+    }
+    else if (mode == PlaneRaw) {
+        if (in + n > end) throw std::runtime_error("snapshot codec: truncated block");
+        std::memcpy(out, in, n);
+        in += n;
+    }
+    else {
+        throw std::runtime_error("snapshot codec: unknown plane mode");
+    }
+}
+
+template<int Size> struct uint_of_size;
+template<> struct uint_of_size<4> { using type = std::uint32_t; };
+template<> struct uint_of_size<8> { using type = std::uint64_t; };
+
+} // namespace snapcodec
+
+class SnapshotEncoder
+{
+public:
+    virtual ~SnapshotEncoder() = default;
+    // appends the encoded block to out
+    virtual void encode(const char * data, std::size_t length, std::size_t elemSize,
+                        bool keyframe, std::vector<char> & out) = 0;
+    // largest pointwise error per variable over everything encoded so far, empty if lossless
+    virtual std::vector<double> maxError() const { return {}; }
+};
+
+class SnapshotDecoder
+{
+public:
+    virtual ~SnapshotDecoder() = default;
+    // decodes length scalars into out; non-keyframes require the preceding record to have been decoded
+    virtual void decode(const char * in, std::size_t nbytes, std::size_t length, std::size_t elemSize,
+                        bool keyframe, char * out) = 0;
+};
+
+/*
+    Lossless temporal-delta codec
+
+    The scalar bits are XORed against the previously stored sample (zero for keyframes),
+    so slowly changing states leave mostly-zero high bytes. The result is split into
+    chunks, each chunk is shuffled into byte planes, and each plane is entropy coded.
+    Block layout: [uint32 chunkLength][plane x elemSize] per chunk.
+*/
+
+class LosslessDeltaEncoder : public SnapshotEncoder
+{
+public:
+    static constexpr std::size_t chunkLength = 65536;
+
+    void encode(const char * data, std::size_t length, std::size_t elemSize,
+                bool keyframe, std::vector<char> & out) override
+    {
+        if (elemSize == 8) encode_impl<8>(data, length, keyframe, out);
+        else if (elemSize == 4) encode_impl<4>(data, length, keyframe, out);
+        else throw std::runtime_error("LosslessDeltaEncoder: unsupported scalar size");
+    }
+
+private:
+    template<int Size>
+    void encode_impl(const char * data, std::size_t length, bool keyframe, std::vector<char> & out)
+    {
+        using word_t = typename snapcodec::uint_of_size<Size>::type;
+        if (keyframe || (prev_.size() != length * Size)) prev_.assign(length * Size, 0);
+
+        for (std::size_t start = 0; start < length; start += chunkLength) {
+            const std::size_t count = std::min(chunkLength, length - start);
+            planes_.resize(count * Size);
+            for (std::size_t i = 0; i < count; ++i) {
+                word_t cur, old;
+                std::memcpy(&cur, data + (start + i) * Size, Size);
+                std::memcpy(&old, prev_.data() + (start + i) * Size, Size);
+                const word_t delta = cur ^ old;
+                for (int byteIdx = 0; byteIdx < Size; ++byteIdx) {
+                    planes_[byteIdx * count + i] = static_cast<std::uint8_t>(delta >> (8 * byteIdx));
+                }
+            }
+            snapcodec::put(out, static_cast<std::uint32_t>(count));
+            for (int byteIdx = 0; byteIdx < Size; ++byteIdx) {
+                snapcodec::encode_plane(planes_.data() + byteIdx * count, count, out);
+            }
+        }
+        std::memcpy(prev_.data(), data, length * Size);
+    }
+
+    std::vector<char> prev_;
+    std::vector<std::uint8_t> planes_;
+};
+
+class LosslessDeltaDecoder : public SnapshotDecoder
+{
+public:
+    void decode(const char * in, std::size_t nbytes, std::size_t length, std::size_t elemSize,
+                bool keyframe, char * out) override
+    {
+        if (elemSize == 8) decode_impl<8>(in, nbytes, length, keyframe, out);
+        else if (elemSize == 4) decode_impl<4>(in, nbytes, length, keyframe, out);
+        else throw std::runtime_error("LosslessDeltaDecoder: unsupported scalar size");
+    }
+
+private:
+    template<int Size>
+    void decode_impl(const char * in, std::size_t nbytes, std::size_t length, bool keyframe, char * out)
+    {
+        using word_t = typename snapcodec::uint_of_size<Size>::type;
+        if (keyframe) prev_.assign(length * Size, 0);
+        else if (prev_.size() != length * Size) {
+            throw std::runtime_error("LosslessDeltaDecoder: delta record without preceding keyframe");
+        }
+
+        const char * end = in + nbytes;
+        std::size_t start = 0;
+        while (start < length) {
+            const std::size_t count = snapcodec::get<std::uint32_t>(in, end);
+            if (start + count > length) throw std::runtime_error("LosslessDeltaDecoder: corrupt block");
+            planes_.resize(count * Size);
+            for (int byteIdx = 0; byteIdx < Size; ++byteIdx) {
+                snapcodec::decode_plane(in, end, planes_.data() + byteIdx * count, count);
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                word_t delta = 0, old;
+                for (int byteIdx = 0; byteIdx < Size; ++byteIdx) {
+                    delta |= static_cast<word_t>(planes_[byteIdx * count + i]) << (8 * byteIdx);
+                }
+                std::memcpy(&old, prev_.data() + (start + i) * Size, Size);
+                const word_t cur = old ^ delta;
+                std::memcpy(prev_.data() + (start + i) * Size, &cur, Size);
+            }
+            start += count;
+        }
+        std::memcpy(out, prev_.data(), length * Size);
+    }
+
+    std::vector<char> prev_;
+    std::vector<std::uint8_t> planes_;
+};
+
+/*
+    Error-bounded lossy codec (SZ-style predict and quantize)
+
+    Each variable of a cell-interleaved block is predicted from already reconstructed
+    values: the previous cell of the same variable for keyframes, the previously stored
+    sample otherwise. The prediction residual is quantized into bins of width 2*eb;
+    values whose reconstruction would miss the bound are stored verbatim.
+    Block layout:
+        [uint32 nvars][double eb x nvars][double maxError x nvars][uint64 numUnpredictable]
+        [uint32 chunkLength][plane x 2] per chunk of uint16 codes
+        [scalar x numUnpredictable]
+*/
+
+namespace snapcodec {
+
+constexpr std::int64_t quantRadius = 32768;
+
+} // namespace snapcodec
+
+class LossyQuantizeEncoder : public SnapshotEncoder
+{
+public:
+    static constexpr std::size_t chunkLength = 65536;
+
+    LossyQuantizeEncoder(int nvars, double errorBound, ErrorBoundMode mode)
+        : nvars_(nvars > 0 ? nvars : 1), errorBound_(errorBound), mode_(mode),
+        maxError_(nvars_, 0.0)
+    {
+        if (!(errorBound_ > 0.0)) throw std::runtime_error("LossyQuantizeEncoder: error bound must be positive");
+    }
+
+    void encode(const char * data, std::size_t length, std::size_t elemSize,
+                bool keyframe, std::vector<char> & out) override
+    {
+        if (elemSize == 8) encode_impl<double>(data, length, keyframe, out);
+        else if (elemSize == 4) encode_impl<float>(data, length, keyframe, out);
+        else throw std::runtime_error("LossyQuantizeEncoder: unsupported scalar size");
+    }
+
+    std::vector<double> maxError() const override { return maxError_; }
+
+private:
+    template<class ScalarType>
+    void encode_impl(const char * data, std::size_t length, bool keyframe, std::vector<char> & out)
+    {
+        const auto * vals = reinterpret_cast<const ScalarType *>(data);
+        const bool temporal = !keyframe && (prev_.size() == length);
+        prev_.resize(length);
+
+        // per-variable bin half-widths
+        std::vector<double> eb(nvars_, errorBound_);
+        if (mode_ == ErrorBoundMode::Relative) {
+            std::vector<double> lo(nvars_, HUGE_VAL), hi(nvars_, -HUGE_VAL);
+            for (std::size_t i = 0; i < length; ++i) {
+                const auto var = i % nvars_;
+                lo[var] = std::min(lo[var], static_cast<double>(vals[i]));
+                hi[var] = std::max(hi[var], static_cast<double>(vals[i]));
+            }
+            for (int var = 0; var < nvars_; ++var) {
+                // a constant variable is reproduced exactly by the predictor or stored verbatim
+                eb[var] = std::max(errorBound_ * (hi[var] - lo[var]), std::numeric_limits<double>::min());
+            }
+        }
+
+        codes_.resize(length);
+        std::vector<ScalarType> unpredictable;
+        std::vector<double> recordError(nvars_, 0.0);
+        for (std::size_t i = 0; i < length; ++i) {
+            const auto var = i % nvars_;
+            const double val = vals[i];
+            double pred = 0.0;
+            if (temporal) pred = prev_[i];
+            else if (i >= static_cast<std::size_t>(nvars_)) pred = prev_[i - nvars_];
+
+            const double q = std::nearbyint((val - pred) / (2.0 * eb[var]));
+            bool predictable = std::abs(q) < snapcodec::quantRadius;
+            double recon = 0.0;
+            if (predictable) {
+                recon = static_cast<double>(static_cast<ScalarType>(pred + 2.0 * eb[var] * q));
+                predictable = std::abs(recon - val) <= eb[var];
+            }
+            if (predictable) {
+                codes_[i] = static_cast<std::uint16_t>(static_cast<std::int64_t>(q) + snapcodec::quantRadius);
+                recordError[var] = std::max(recordError[var], std::abs(recon - val));
+            }
+            else {
+                codes_[i] = 0;
+                recon = val;
+                unpredictable.push_back(vals[i]);
+            }
+            prev_[i] = recon;
+        }
+
+        snapcodec::put(out, static_cast<std::uint32_t>(nvars_));
+        for (int var = 0; var < nvars_; ++var) snapcodec::put(out, eb[var]);
+        for (int var = 0; var < nvars_; ++var) {
+            snapcodec::put(out, recordError[var]);
+            maxError_[var] = std::max(maxError_[var], recordError[var]);
+        }
+        snapcodec::put(out, static_cast<std::uint64_t>(unpredictable.size()));
+
+        for (std::size_t start = 0; start < length; start += chunkLength) {
+            const std::size_t count = std::min(chunkLength, length - start);
+            planes_.resize(2 * count);
+            for (std::size_t i = 0; i < count; ++i) {
+                planes_[i]         = static_cast<std::uint8_t>(codes_[start + i] & 0xff);
+                planes_[count + i] = static_cast<std::uint8_t>(codes_[start + i] >> 8);
+            }
+            snapcodec::put(out, static_cast<std::uint32_t>(count));
+            snapcodec::encode_plane(planes_.data(), count, out);
+            snapcodec::encode_plane(planes_.data() + count, count, out);
+        }
+
+        const auto pos = out.size();
+        out.resize(pos + unpredictable.size() * sizeof(ScalarType));
+        std::memcpy(out.data() + pos, unpredictable.data(), unpredictable.size() * sizeof(ScalarType));
+    }
+
+    int nvars_;
+    double errorBound_;
+    ErrorBoundMode mode_;
+    std::vector<double> maxError_;
+    std::vector<double> prev_;
+    std::vector<std::uint16_t> codes_;
+    std::vector<std::uint8_t> planes_;
+};
+
+class LossyQuantizeDecoder : public SnapshotDecoder
+{
+public:
+    void decode(const char * in, std::size_t nbytes, std::size_t length, std::size_t elemSize,
+                bool keyframe, char * out) override
+    {
+        if (elemSize == 8) decode_impl<double>(in, nbytes, length, keyframe, out);
+        else if (elemSize == 4) decode_impl<float>(in, nbytes, length, keyframe, out);
+        else throw std::runtime_error("LossyQuantizeDecoder: unsupported scalar size");
+    }
+
+    // largest pointwise error per variable the encoder measured for one block
+    static std::vector<double> block_max_error(const char * in, std::size_t nbytes)
+    {
+        const char * end = in + nbytes;
+        const auto nvars = snapcodec::get<std::uint32_t>(in, end);
+        in += nvars * sizeof(double);
+        std::vector<double> err(nvars);
+        for (auto & val : err) val = snapcodec::get<double>(in, end);
+        return err;
+    }
+
+private:
+    template<class ScalarType>
+    void decode_impl(const char * in, std::size_t nbytes, std::size_t length, bool keyframe, char * out)
+    {
+        const char * end = in + nbytes;
+        if (!keyframe && (prev_.size() != length)) {
+            throw std::runtime_error("LossyQuantizeDecoder: delta record without preceding keyframe");
+        }
+        prev_.resize(length);
+
+        const std::size_t nvars = snapcodec::get<std::uint32_t>(in, end);
+        std::vector<double> eb(nvars);
+        for (auto & val : eb) val = snapcodec::get<double>(in, end);
+        in += nvars * sizeof(double);
+        const auto numUnpredictable = snapcodec::get<std::uint64_t>(in, end);
+
+        codes_.resize(length);
+        std::size_t start = 0;
+        while (start < length) {
+            const std::size_t count = snapcodec::get<std::uint32_t>(in, end);
+            if (start + count > length) throw std::runtime_error("LossyQuantizeDecoder: corrupt block");
+            planes_.resize(2 * count);
+            snapcodec::decode_plane(in, end, planes_.data(), count);
+            snapcodec::decode_plane(in, end, planes_.data() + count, count);
+            for (std::size_t i = 0; i < count; ++i) {
+                codes_[start + i] = static_cast<std::uint16_t>(planes_[i] | (planes_[count + i] << 8));
+            }
+            start += count;
+        }
+
+        if (in + numUnpredictable * sizeof(ScalarType) > end) throw std::runtime_error("LossyQuantizeDecoder: truncated block");
+        const auto * unpredictable = reinterpret_cast<const ScalarType *>(in);
+        auto * vals = reinterpret_cast<ScalarType *>(out);
+        std::size_t unpredIdx = 0;
+        for (std::size_t i = 0; i < length; ++i) {
+            if (codes_[i] == 0) {
+                if (unpredIdx >= numUnpredictable) throw std::runtime_error("LossyQuantizeDecoder: corrupt block");
+                ScalarType val;
+                std::memcpy(&val, unpredictable + unpredIdx++, sizeof(ScalarType));
+                vals[i] = val;
+            }
+            else {
+                double pred = 0.0;
+                if (!keyframe) pred = prev_[i];
+                else if (i >= nvars) pred = prev_[i - nvars];
+                const double q = static_cast<double>(static_cast<std::int64_t>(codes_[i]) - snapcodec::quantRadius);
+                vals[i] = static_cast<ScalarType>(pred + 2.0 * eb[i % nvars] * q);
+            }
+            prev_[i] = vals[i];
+        }
+    }
+
+    std::vector<double> prev_;
+    std::vector<std::uint16_t> codes_;
+    std::vector<std::uint8_t> planes_;
+};
+
+inline std::unique_ptr<SnapshotEncoder> create_snapshot_encoder(
+    SnapshotCodecType codec, int nvars, double errorBound, ErrorBoundMode mode)
+{
+    switch (codec) {
+        case SnapshotCodecType::None:     return nullptr;
+        case SnapshotCodecType::Lossless: return std::make_unique<LosslessDeltaEncoder>();
+        case SnapshotCodecType::Lossy:    return std::make_unique<LossyQuantizeEncoder>(nvars, errorBound, mode);
+    }
+    throw std::runtime_error("create_snapshot_encoder: unknown codec");
+}
+
+inline std::unique_ptr<SnapshotDecoder> create_snapshot_decoder(SnapshotCodecType codec)
+{
+    switch (codec) {
+        case SnapshotCodecType::None:     return nullptr;
+        case SnapshotCodecType::Lossless: return std::make_unique<LosslessDeltaDecoder>();
+        case SnapshotCodecType::Lossy:    return std::make_unique<LossyQuantizeDecoder>();
+    }
+    throw std::runtime_error("create_snapshot_decoder: unknown codec");
+}
+
+#endif
@@ -0,0 +1,1250 @@
+#ifndef PDAS_EXPERIMENTS_SNAPSHOT_IO_HPP_
+#define PDAS_EXPERIMENTS_SNAPSHOT_IO_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Eigen/Core>
+
+#include "snapshot_codecs.hpp"
+
+enum class SnapshotFormat { Raw, Indexed };
+enum class SnapshotPrecision { Float64, Float32 };
+enum class SnapshotLayout { CellInterleaved = 0, VariableMajor = 1 };
+
+// Snapshot output settings, filled by the parser and shared by all observers of a run
+struct SnapshotConfig
+{
+    SnapshotFormat format = SnapshotFormat::Raw;
+    SnapshotCodecType codec = SnapshotCodecType::None;
+    SnapshotPrecision precision = SnapshotPrecision::Float64;  // stored precision, the solver is unaffected
+    SnapshotLayout layout = SnapshotLayout::CellInterleaved;   // stored order of full states, uncompressed only
+    int keyframeInterval = 32;  // records between self-contained records for temporal codecs, 0: first only
+    double errorBound = 0.0;    // lossy codec only
+    ErrorBoundMode errorBoundMode = ErrorBoundMode::Absolute;
+    bool container  = false;    // decomposed runs: all subdomains in one file
+    bool preallocate = false;   // mmap'd output sized from expectedRecords, uncompressed only
+    double adaptiveThreshold = 0.0;  // relative change that triggers a sample, 0: fixed-rate sampling
+    int adaptiveMinInterval = 1;     // steps
+    int adaptiveMaxInterval = 0;     // steps, 0: no limit
+    std::size_t expectedRecords = 0;  // set by the driver, 0: unknown
+    bool append     = false;    // set by the driver on restart: continue existing files
+    std::size_t batchRecords = 0;   // reduced-state files: records gathered in memory per write, 0: no batching
+    std::size_t batchBytes   = 0;   // reduced-state files: byte budget of a batch, 0: no budget
+    bool async      = false;
+    int queueDepth  = 4;
+};
+
+inline SnapshotFormat string_to_snapshot_format(const std::string & strIn)
+{
+    if      (strIn == "raw")     { return SnapshotFormat::Raw; }
+    else if (strIn == "indexed") { return SnapshotFormat::Indexed; }
+    else {
+        throw std::runtime_error("string_to_snapshot_format: Invalid snapshotFormat " + strIn);
+    }
+}
+
+inline SnapshotPrecision string_to_snapshot_precision(const std::string & strIn)
+{
+    if      (strIn == "float64") { return SnapshotPrecision::Float64; }
+    else if (strIn == "float32") { return SnapshotPrecision::Float32; }
+    else {
+        throw std::runtime_error("string_to_snapshot_precision: Invalid snapshotPrecision " + strIn);
+    }
+}
+
+inline SnapshotLayout string_to_snapshot_layout(const std::string & strIn)
+{
+    if      (strIn == "cell")     { return SnapshotLayout::CellInterleaved; }
+    else if (strIn == "variable") { return SnapshotLayout::VariableMajor; }
+    else {
+        throw std::runtime_error("string_to_snapshot_layout: Invalid snapshotLayout " + strIn);
+    }
+}
+
+// batching is meant for small reduced states, full states go out one record at a time
+inline SnapshotConfig full_state_config(SnapshotConfig config)
+{
+    config.batchRecords = 0;
+    config.batchBytes = 0;
+    return config;
+}
+
+// samples taken by an observer at step 0 and every sampleFreq steps after it
+inline std::size_t expected_snapshot_count(int numSteps, int sampleFreq)
+{
+    if ((numSteps < 0) || (sampleFreq <= 0)) return 0;
+    return static_cast<std::size_t>(numSteps / sampleFreq) + 1;
+}
+
+/*
+    Byte destinations for observer output
+*/
+
+class ByteSink
+{
+public:
+    virtual ~ByteSink() = default;
+    virtual void write(const char * data, std::size_t nbytes) = 0;
+    virtual void flush() {}
+};
+
+class StreamSink : public ByteSink
+{
+public:
+    explicit StreamSink(const std::string & f0, bool append = false)
+        : fileName_(f0), file_(f0, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc))
+    {
+        if (!file_) throw std::runtime_error("Could not open " + f0);
+    }
+
+    ~StreamSink() override { file_.close(); }
+
+    void write(const char * data, std::size_t nbytes) override
+    {
+        file_.write(data, nbytes);
+        if (!file_) throw std::runtime_error("Failed writing to " + fileName_);
+    }
+
+    void flush() override { file_.flush(); }
+
+private:
+    std::string fileName_;
+    std::ofstream file_;
+};
+
+// Writes into a memory-mapped file preallocated to its expected final size,
+// so a write is a memcpy and the kernel writes pages back when it sees fit.
+// Grows (and remaps) if the estimate was too small, trims the file on close.
+// Until then the written bytes are followed by endMarker, so a file left untrimmed by a
+// crash shows where its data ends instead of running into the preallocated zeros.
+class MappedSink : public ByteSink
+{
+public:
+    static constexpr char endMarker[8] = {'P', 'D', 'A', 'S', 'E', 'N', 'D', '\0'};
+
+    MappedSink(const std::string & f0, std::size_t capacity)
+        : fileName_(f0)
+    {
+        fd_ = ::open(f0.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) throw std::runtime_error("Could not open " + f0);
+        reserve(std::max(capacity, sizeof(endMarker)));
+    }
+
+    MappedSink(const MappedSink &) = delete;
+    MappedSink & operator=(const MappedSink &) = delete;
+
+    ~MappedSink() override
+    {
+        if (data_ != nullptr) ::munmap(data_, capacity_);
+        if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+            std::cerr << "MappedSink: could not trim " << fileName_ << std::endl;
+        }
+        ::close(fd_);
+    }
+
+    void write(const char * data, std::size_t nbytes) override
+    {
+        if (size_ + nbytes + sizeof(endMarker) > capacity_) {
+            reserve(std::max(2 * capacity_, size_ + nbytes + sizeof(endMarker)));
+        }
+        // the old marker is overwritten last, so it stays in place until the new bytes and marker are
+        const std::size_t head = std::min(nbytes, sizeof(endMarker));
+        std::memcpy(data_ + size_ + head, data + head, nbytes - head);
+        std::memcpy(data_ + size_ + nbytes, endMarker, sizeof(endMarker));
+        std::memcpy(data_ + size_, data, head);
+        size_ += nbytes;
+    }
+
+    // start writeback without waiting for it
+    void flush() override
+    {
+        if (::msync(data_, capacity_, MS_ASYNC) != 0) {
+            throw std::runtime_error("MappedSink: msync failed for " + fileName_);
+        }
+    }
+
+private:
+    void reserve(std::size_t capacity)
+    {
+        if (data_ != nullptr) ::munmap(data_, capacity_);
+        data_ = nullptr;
+
+        // fallocate is not supported everywhere, a sparse file still avoids growing on every write
+        if (::posix_fallocate(fd_, 0, static_cast<off_t>(capacity)) != 0) {
+            if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0) {
+                throw std::runtime_error("MappedSink: could not size " + fileName_);
+            }
+        }
+        void * addr = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) throw std::runtime_error("MappedSink: could not map " + fileName_);
+        data_ = static_cast<char *>(addr);
+        capacity_ = capacity;
+        if (size_ == 0) std::memcpy(data_, endMarker, sizeof(endMarker));
+    }
+
+    std::string fileName_;
+    int fd_ = -1;
+    char * data_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+};
+
+// Single background thread draining a bounded queue of write jobs.
+// One instance may be shared by any number of sinks; jobs are written in submission order.
+// The queue is a ring of queueDepth slots and written buffers are pooled, so once the pool
+// holds buffers of the record size a write allocates nothing.
+class AsyncWriter
+{
+public:
+    explicit AsyncWriter(int queueDepth)
+        : queueDepth_(queueDepth > 0 ? static_cast<std::size_t>(queueDepth) : 1),
+        queue_(queueDepth_)
+    {
+        pool_.reserve(queueDepth_ + 2);   // every buffer in circulation: queued, being written, being filled
+        worker_ = std::thread([this]{ this->run(); });
+    }
+
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter & operator=(const AsyncWriter &) = delete;
+
+    ~AsyncWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        jobReady_.notify_all();
+        worker_.join();
+    }
+
+    // buffer of (at least) nbytes, recycled from previously written jobs if possible
+    std::vector<char> acquire(std::size_t nbytes)
+    {
+        std::vector<char> buf;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!pool_.empty()) {
+                buf = std::move(pool_.back());
+                pool_.pop_back();
+            }
+        }
+        buf.resize(nbytes);
+        return buf;
+    }
+
+    // blocks the caller while the queue is full
+    void submit(std::shared_ptr<ByteSink> sink, std::vector<char> && buf)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotFree_.wait(lock, [this]{ return (numQueued_ < queueDepth_) || error_; });
+        rethrow_if_failed();
+        queue_[(head_ + numQueued_) % queueDepth_] = {std::move(sink), std::move(buf)};
+        ++numQueued_;
+        lock.unlock();
+        jobReady_.notify_one();
+    }
+
+    // wait until every submitted job has been written
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotFree_.wait(lock, [this]{ return ((numQueued_ == 0) && !busy_) || error_; });
+        rethrow_if_failed();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            jobReady_.wait(lock, [this]{ return stop_ || (numQueued_ > 0); });
+            if (numQueued_ == 0) break;
+
+            auto job = std::move(queue_[head_]);
+            head_ = (head_ + 1) % queueDepth_;
+            --numQueued_;
+            busy_ = true;
+            lock.unlock();
+
+            try {
+                job.first->write(job.second.data(), job.second.size());
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> errLock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+            job.first.reset();
+
+            lock.lock();
+            busy_ = false;
+            pool_.push_back(std::move(job.second));
+            slotFree_.notify_all();
+        }
+    }
+
+    // caller must hold mutex_
+    void rethrow_if_failed()
+    {
+        if (error_) {
+            auto err = error_;
+            error_ = nullptr;
+            std::rethrow_exception(err);
+        }
+    }
+
+    using job_t = std::pair<std::shared_ptr<ByteSink>, std::vector<char>>;
+
+    std::size_t queueDepth_;
+    std::vector<job_t> queue_;              // ring of queued jobs, from head_
+    std::size_t head_ = 0;
+    std::size_t numQueued_ = 0;
+    std::vector<std::vector<char>> pool_;
+    bool stop_ = false;
+    bool busy_ = false;
+    std::exception_ptr error_ = nullptr;
+    std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable slotFree_;
+    std::thread worker_;
+};
+
+// Copies each write into a pooled buffer and hands it to an AsyncWriter
+class AsyncSink : public ByteSink
+{
+public:
+    AsyncSink(std::shared_ptr<ByteSink> target, std::shared_ptr<AsyncWriter> writer)
+        : target_(std::move(target)), writer_(std::move(writer))
+    {}
+
+    ~AsyncSink() override
+    {
+        // pending jobs keep target_ alive, just make sure they land before returning
+        try { writer_->drain(); } catch (...) {}
+    }
+
+    void write(const char * data, std::size_t nbytes) override
+    {
+        auto buf = writer_->acquire(nbytes);
+        std::memcpy(buf.data(), data, nbytes);
+        writer_->submit(target_, std::move(buf));
+    }
+
+    void flush() override
+    {
+        writer_->drain();
+        target_->flush();
+    }
+
+private:
+    std::shared_ptr<ByteSink> target_;
+    std::shared_ptr<AsyncWriter> writer_;
+};
+
+inline std::shared_ptr<AsyncWriter> create_async_writer(const SnapshotConfig & config)
+{
+    if (!config.async) return nullptr;
+    return std::make_shared<AsyncWriter>(config.queueDepth);
+}
+
+// capacity > 0: preallocated memory-mapped file of that many bytes, otherwise stream writes;
+// append continues an existing file and is always a stream
+inline std::unique_ptr<ByteSink> create_sink(
+    const std::string & f0,
+    std::shared_ptr<AsyncWriter> writer,
+    std::size_t capacity = 0,
+    bool append = false)
+{
+    std::unique_ptr<ByteSink> target;
+    if ((capacity > 0) && !append) target = std::make_unique<MappedSink>(f0, capacity);
+    else                            target = std::make_unique<StreamSink>(f0, append);
+
+    if (writer) {
+        return std::make_unique<AsyncSink>(std::move(target), std::move(writer));
+    }
+    return target;
+}
+
+/*
+    Self-describing snapshot file ("indexed" format)
+
+    [FileHeader][BlockInfo x numBlocks]
+    records: [RecordHeader][uint64 block byte counts x numBlocks][block data ...]
+    [IndexEntry x numRecords][IndexFooter]
+
+    A record holds one sampled step; each block is one stored vector (a single block for
+    monolithic runs). The trailing index gives O(1) access to any record. If a run dies
+    before the index is written, readers fall back to walking the record headers, up to
+    MappedSink::endMarker in a preallocated file or the first record that is not plausibly
+    the next one (see snapfmt::record_fits and snapfmt::record_blocks_match).
+*/
+
+namespace snapfmt {
+
+constexpr char headerMagic[8] = {'P', 'D', 'A', 'S', 'S', 'N', 'A', 'P'};
+constexpr char indexMagic[8]  = {'P', 'D', 'A', 'S', 'I', 'N', 'D', 'X'};
+constexpr std::uint32_t version = 1;
+
+enum DType : std::uint32_t { Float64 = 1, Float32 = 2 };
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dtype;
+    std::uint32_t codec;    // SnapshotCodecType
+    std::uint32_t layout;   // SnapshotLayout; 0: cell-interleaved, as produced by the solver,
+                            // 1: variable-major, each block stored as nvars contiguous chunks
+    std::uint64_t numBlocks;
+    std::uint64_t sampleFreq;
+    double dt;
+};
+
+struct BlockInfo
+{
+    std::uint64_t length;   // number of scalars
+    std::uint64_t nvars;    // degrees of freedom per cell, 1 for reduced states
+};
+
+struct RecordHeader
+{
+    std::int64_t step;
+    double time;
+    std::uint64_t nbytes;   // everything after this header, block table included
+    std::uint32_t flags;    // RecordFlags
+    std::uint32_t reserved;
+};
+
+enum RecordFlags : std::uint32_t { Keyframe = 1 };
+
+struct IndexEntry
+{
+    std::int64_t step;
+    double time;
+    std::uint64_t offset;   // file offset of the RecordHeader
+};
+
+struct IndexFooter
+{
+    std::uint64_t indexOffset;
+    std::uint64_t numRecords;
+    char magic[8];
+};
+
+static_assert(sizeof(FileHeader)   == 48, "unexpected FileHeader padding");
+static_assert(sizeof(BlockInfo)    == 16, "unexpected BlockInfo padding");
+static_assert(sizeof(RecordHeader) == 32, "unexpected RecordHeader padding");
+static_assert(sizeof(IndexEntry)   == 24, "unexpected IndexEntry padding");
+static_assert(sizeof(IndexFooter)  == 24, "unexpected IndexFooter padding");
+
+// whether rec, read at a record offset with available bytes left in the file, can be the record
+// after step prevStep; fails on a torn record and on the zeros past the data of an untrimmed file
+inline bool record_fits(const RecordHeader & rec, std::int64_t prevStep,
+                        std::uint64_t numBlocks, std::uint64_t available)
+{
+    return (rec.nbytes > 0) && (rec.nbytes >= numBlocks * sizeof(std::uint64_t))
+        && (rec.nbytes <= available - sizeof(RecordHeader)) && (rec.step > prevStep);
+}
+
+// whether a fitting record's table of numBlocks block sizes adds up to its size; storedSizes holds
+// the bytes of each block of an uncompressed file and is empty for compressed ones, whose sizes vary
+inline bool record_blocks_match(const RecordHeader & rec, const char * blockTable,
+                                std::uint64_t numBlocks, const std::vector<std::uint64_t> & storedSizes)
+{
+    std::uint64_t total = numBlocks * sizeof(std::uint64_t);
+    for (std::uint64_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+        std::uint64_t blockSize;
+        std::memcpy(&blockSize, blockTable + blockIdx * sizeof(std::uint64_t), sizeof(blockSize));
+        if (blockSize > rec.nbytes - total) return false;
+        if (!storedSizes.empty() && (blockSize != storedSizes[blockIdx])) return false;
+        total += blockSize;
+    }
+    return total == rec.nbytes;
+}
+
+template<class T>
+void append_bytes(std::vector<char> & buf, const T & val)
+{
+    const auto pos = buf.size();
+    buf.resize(pos + sizeof(T));
+    std::memcpy(buf.data() + pos, &val, sizeof(T));
+}
+
+inline std::uint32_t dtype_of_size(std::size_t elemSize)
+{
+    if (elemSize == sizeof(double)) return DType::Float64;
+    if (elemSize == sizeof(float))  return DType::Float32;
+    throw std::runtime_error("Unsupported snapshot scalar size: " + std::to_string(elemSize));
+}
+
+inline std::size_t size_of_dtype(std::uint32_t dtype)
+{
+    if (dtype == DType::Float64) return sizeof(double);
+    if (dtype == DType::Float32) return sizeof(float);
+    throw std::runtime_error("Unsupported snapshot dtype: " + std::to_string(dtype));
+}
+
+} // namespace snapfmt
+
+// Change-triggered sampling: a state is kept once its relative change (2-norm over all blocks)
+// since the last kept state exceeds the threshold, no sooner than minInterval steps after it,
+// and always after maxInterval steps. Always accepts when the threshold is zero.
+class AdaptiveSampler
+{
+public:
+    AdaptiveSampler() = default;
+
+    AdaptiveSampler(double threshold, int minInterval, int maxInterval)
+        : threshold_(threshold), minInterval_(minInterval), maxInterval_(maxInterval){}
+
+    explicit AdaptiveSampler(const SnapshotConfig & config)
+        : AdaptiveSampler(config.adaptiveThreshold, config.adaptiveMinInterval, config.adaptiveMaxInterval){}
+
+    bool enabled() const { return threshold_ > 0.0; }
+
+    bool accept(std::int64_t step, const std::vector<std::pair<const char *, std::size_t>> & blocks,
+                std::size_t elemSize)
+    {
+        if (!enabled()) return true;
+
+        if (lastStep_ >= 0) {
+            const auto interval = step - lastStep_;
+            if (interval < minInterval_) return false;
+            if ((maxInterval_ <= 0) || (interval < maxInterval_)) {
+                const bool changed = (elemSize == sizeof(double))
+                    ? relative_change<double>(blocks) > threshold_
+                    : relative_change<float>(blocks) > threshold_;
+                if (!changed) return false;
+            }
+        }
+
+        // keep a copy to measure the next change against
+        std::size_t total = 0;
+        for (const auto & block : blocks) total += block.second * elemSize;
+        last_.resize(total);
+        std::size_t pos = 0;
+        for (const auto & block : blocks) {
+            std::memcpy(last_.data() + pos, block.first, block.second * elemSize);
+            pos += block.second * elemSize;
+        }
+        lastStep_ = step;
+        return true;
+    }
+
+private:
+    template<class ScalarType>
+    double relative_change(const std::vector<std::pair<const char *, std::size_t>> & blocks) const
+    {
+        using vec_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, 1>;
+        double diffSq = 0.0, refSq = 0.0;
+        const ScalarType * last = reinterpret_cast<const ScalarType *>(last_.data());
+        for (const auto & block : blocks) {
+            const auto length = static_cast<Eigen::Index>(block.second);
+            Eigen::Map<const vec_t> cur(reinterpret_cast<const ScalarType *>(block.first), length);
+            Eigen::Map<const vec_t> prev(last, length);
+            diffSq += static_cast<double>((cur - prev).squaredNorm());
+            refSq  += static_cast<double>(prev.squaredNorm());
+            last += length;
+        }
+        if (refSq == 0.0) return (diffSq > 0.0) ? std::numeric_limits<double>::infinity() : 0.0;
+        return std::sqrt(diffSq / refSq);
+    }
+
+    double threshold_ = 0.0;
+    std::int64_t minInterval_ = 1;
+    std::int64_t maxInterval_ = 0;
+    std::int64_t lastStep_ = -1;
+    std::vector<char> last_;
+};
+
+// Frames sampled vectors into a sink according to SnapshotConfig::format.
+// For the raw format only the vector data is written, as before.
+class SnapshotFileWriter
+{
+public:
+    SnapshotFileWriter() = default;
+
+    SnapshotFileWriter(const std::string & f0, const SnapshotConfig & config,
+                       std::vector<int> nvarsVec, int sampleFreq, double dt,
+                       std::shared_ptr<AsyncWriter> writer = nullptr)
+        : fileName_(f0), writer_(std::move(writer)), config_(config),
+        format_(config.format), codec_(config.codec), keyframeInterval_(config.keyframeInterval),
+        nvarsVec_(std::move(nvarsVec)), sampleFreq_(sampleFreq), dt_(dt)
+    {
+        if ((format_ == SnapshotFormat::Raw) && (codec_ != SnapshotCodecType::None)) {
+            throw std::runtime_error("SnapshotFileWriter: compressed snapshots require the indexed format");
+        }
+        if ((format_ == SnapshotFormat::Raw) && (config_.precision != SnapshotPrecision::Float64)) {
+            throw std::runtime_error("SnapshotFileWriter: float32 snapshots require the indexed format");
+        }
+        if ((config_.layout != SnapshotLayout::CellInterleaved) &&
+            ((format_ == SnapshotFormat::Raw) || (codec_ != SnapshotCodecType::None))) {
+            throw std::runtime_error("SnapshotFileWriter: variable-major snapshots require the uncompressed indexed format");
+        }
+
+        // index entries of the expected records up front, so writing a record does not allocate
+        if (format_ == SnapshotFormat::Indexed) index_.reserve(config_.expectedRecords);
+
+        if (config_.append) {
+            resume();
+            sink_ = create_sink(fileName_, writer_, 0, true);
+        }
+        // a preallocated file is sized on the first write, once the vector lengths are known
+        else if (!preallocated()) {
+            sink_ = create_sink(fileName_, writer_);
+        }
+    }
+
+    SnapshotFileWriter(SnapshotFileWriter &&) = default;
+    SnapshotFileWriter & operator=(SnapshotFileWriter &&) = default;
+
+    // errors past this point can only be reported, an exception would terminate
+    ~SnapshotFileWriter()
+    {
+        if (!sink_) return;
+        try {
+            close();
+        }
+        catch (const std::exception & err) {
+            std::cerr << "SnapshotFileWriter: could not finish " << fileName_ << ": " << err.what() << std::endl;
+        }
+        catch (...) {}
+    }
+
+    // one record with a block per (data, length) pair, all blocks share the scalar type
+    void write(std::int64_t step, double time,
+               const std::vector<std::pair<const char *, std::size_t>> & blocks,
+               std::size_t elemSize)
+    {
+        // stored precision and order may differ from the solver's
+        const auto * stored = &blocks;
+        if ((config_.precision == SnapshotPrecision::Float32) && (elemSize == sizeof(double))) {
+            stored = &narrow(*stored);
+            elemSize = sizeof(float);
+        }
+        if (config_.layout == SnapshotLayout::VariableMajor) {
+            stored = &to_variable_major(*stored, elemSize);
+        }
+        write_record(step, time, *stored, elemSize);
+    }
+
+    void flush()
+    {
+        write_batch();
+        if (sink_) sink_->flush();
+    }
+
+    const std::string & fileName() const { return fileName_; }
+
+    // bytes written so far, the index excluded; on disk after flush()
+    std::uint64_t size() const { return offset_; }
+
+    // append the step index, after which no more records may be written
+    void close()
+    {
+        if (format_ == SnapshotFormat::Indexed && headerWritten_ && !closed_) {
+            std::vector<char> tail;
+            for (const auto & entry : index_) snapfmt::append_bytes(tail, entry);
+            snapfmt::IndexFooter footer = {offset_, index_.size(), {}};
+            std::memcpy(footer.magic, snapfmt::indexMagic, 8);
+            snapfmt::append_bytes(tail, footer);
+            write_batch();
+            sink_->write(tail.data(), tail.size());
+            closed_ = true;
+            report_error_bounds();
+        }
+        flush();
+    }
+
+private:
+    void write_record(std::int64_t step, double time,
+                      const std::vector<std::pair<const char *, std::size_t>> & blocks,
+                      std::size_t elemSize)
+    {
+        if (!sink_) {
+            sink_ = create_sink(fileName_, writer_, expected_file_size(blocks, elemSize));
+        }
+
+        if (format_ == SnapshotFormat::Raw) {
+            for (const auto & block : blocks) {
+                emit(block.first, block.second * elemSize);
+                offset_ += block.second * elemSize;
+            }
+            end_record();
+            return;
+        }
+
+        if (!headerWritten_) {
+            write_header(blocks, elemSize);
+        }
+        else if (blocks.size() != lengths_.size()) {
+            throw std::runtime_error("SnapshotFileWriter: block count changed between records");
+        }
+
+        // encode blocks first, their sizes go in the record's block table
+        std::uint32_t flags = 0;
+        if (codec_ != SnapshotCodecType::None) {
+            if (index_.empty() || forceKeyframe_ || ((keyframeInterval_ > 0) && (index_.size() % keyframeInterval_ == 0))) {
+                flags |= snapfmt::RecordFlags::Keyframe;
+            }
+            forceKeyframe_ = false;
+            encoded_.clear();
+            for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+                const auto start = encoded_.size();
+                encoders_[blockIdx]->encode(blocks[blockIdx].first, blocks[blockIdx].second, elemSize,
+                    flags & snapfmt::RecordFlags::Keyframe, encoded_);
+                blockSizes_[blockIdx] = encoded_.size() - start;
+            }
+        }
+        else {
+            flags |= snapfmt::RecordFlags::Keyframe;
+        }
+
+        std::uint64_t payload = blocks.size() * sizeof(std::uint64_t);
+        for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+            if (blocks[blockIdx].second != lengths_[blockIdx]) {
+                throw std::runtime_error("SnapshotFileWriter: vector length changed between records");
+            }
+            if (codec_ == SnapshotCodecType::None) blockSizes_[blockIdx] = blocks[blockIdx].second * elemSize;
+            payload += blockSizes_[blockIdx];
+        }
+
+        record_.clear();
+        snapfmt::RecordHeader rec = {step, time, payload, flags, 0};
+        snapfmt::append_bytes(record_, rec);
+        for (const auto blockSize : blockSizes_) {
+            snapfmt::append_bytes(record_, static_cast<std::uint64_t>(blockSize));
+        }
+        if (codec_ == SnapshotCodecType::None) {
+            for (const auto & block : blocks) {
+                const auto pos = record_.size();
+                record_.resize(pos + block.second * elemSize);
+                std::memcpy(record_.data() + pos, block.first, block.second * elemSize);
+            }
+        }
+        else {
+            record_.insert(record_.end(), encoded_.begin(), encoded_.end());
+        }
+
+        index_.push_back({step, time, offset_});
+        emit(record_.data(), record_.size());
+        offset_ += record_.size();
+        end_record();
+    }
+
+    bool batched() const { return (config_.batchRecords > 0) || (config_.batchBytes > 0); }
+
+    // bytes of the current record, held back while batching
+    void emit(const char * data, std::size_t nbytes)
+    {
+        if (!batched()) {
+            sink_->write(data, nbytes);
+            return;
+        }
+        batch_.insert(batch_.end(), data, data + nbytes);
+    }
+
+    void end_record()
+    {
+        if (!batched()) return;
+        ++batchCount_;
+        if (((config_.batchRecords > 0) && (batchCount_ >= config_.batchRecords)) ||
+            ((config_.batchBytes > 0) && (batch_.size() >= config_.batchBytes))) {
+            write_batch();
+        }
+    }
+
+    // one sink write for every record gathered since the last one
+    void write_batch()
+    {
+        if (batch_.empty()) return;
+        sink_->write(batch_.data(), batch_.size());
+        batch_.clear();
+        batchCount_ = 0;
+    }
+
+    // exact output size is only known for uncompressed records and a known sample count
+    bool preallocated() const
+    {
+        return config_.preallocate && (config_.expectedRecords > 0) && (codec_ == SnapshotCodecType::None);
+    }
+
+    // continue a file truncated to a record boundary by the restart: rebuild the index from the
+    // record headers and start the appended records with a keyframe, the encoders start afresh
+    void resume()
+    {
+        std::ifstream fin(fileName_, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!fin) return;
+        const std::uint64_t fileSize = static_cast<std::uint64_t>(fin.tellg());
+        offset_ = fileSize;
+        if ((format_ == SnapshotFormat::Raw) || (fileSize == 0)) return;
+
+        fin.seekg(0);
+        snapfmt::FileHeader header;
+        fin.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!fin || (std::memcmp(header.magic, snapfmt::headerMagic, 8) != 0)) {
+            throw std::runtime_error("SnapshotFileWriter: cannot append to " + fileName_ + ", not an indexed snapshot file");
+        }
+        const auto dtype = (config_.precision == SnapshotPrecision::Float32) ? snapfmt::DType::Float32 : snapfmt::DType::Float64;
+        if ((header.codec != static_cast<std::uint32_t>(codec_)) || (header.dtype != dtype)
+            || (header.layout != static_cast<std::uint32_t>(config_.layout)) || (header.numBlocks != nvarsVec_.size())) {
+            throw std::runtime_error("SnapshotFileWriter: cannot append to " + fileName_ + ", written with other settings");
+        }
+        for (std::size_t blockIdx = 0; blockIdx < header.numBlocks; ++blockIdx) {
+            snapfmt::BlockInfo info;
+            fin.read(reinterpret_cast<char *>(&info), sizeof(info));
+            if (!fin) throw std::runtime_error("SnapshotFileWriter: cannot append to " + fileName_ + ", truncated block table");
+            lengths_.push_back(info.length);
+            if (codec_ != SnapshotCodecType::None) {
+                encoders_.push_back(create_snapshot_encoder(codec_, nvarsVec_[blockIdx],
+                    config_.errorBound, config_.errorBoundMode));
+            }
+        }
+        blockSizes_.resize(lengths_.size());
+
+        // the same checks as SnapshotReader's walk, a file that fails them is not continued
+        std::vector<std::uint64_t> storedSizes;
+        if (codec_ == SnapshotCodecType::None) {
+            for (const auto length : lengths_) storedSizes.push_back(length * snapfmt::size_of_dtype(dtype));
+        }
+        std::vector<char> blockTable(lengths_.size() * sizeof(std::uint64_t));
+        std::int64_t prevStep = std::numeric_limits<std::int64_t>::min();
+        std::uint64_t pos = sizeof(snapfmt::FileHeader) + lengths_.size() * sizeof(snapfmt::BlockInfo);
+        while (pos + sizeof(snapfmt::RecordHeader) <= fileSize) {
+            snapfmt::RecordHeader rec;
+            fin.seekg(static_cast<std::streamoff>(pos));
+            fin.read(reinterpret_cast<char *>(&rec), sizeof(rec));
+            if (!fin || !snapfmt::record_fits(rec, prevStep, lengths_.size(), fileSize - pos)) break;
+            fin.read(blockTable.data(), blockTable.size());
+            if (!fin || !snapfmt::record_blocks_match(rec, blockTable.data(), lengths_.size(), storedSizes)) break;
+            index_.push_back({rec.step, rec.time, pos});
+            prevStep = rec.step;
+            pos += sizeof(rec) + rec.nbytes;
+        }
+        if (pos != fileSize) {
+            throw std::runtime_error("SnapshotFileWriter: cannot append to " + fileName_ + ", trailing partial record");
+        }
+        headerWritten_ = true;
+        forceKeyframe_ = true;
+    }
+
+    std::size_t expected_file_size(const std::vector<std::pair<const char *, std::size_t>> & blocks,
+                                   std::size_t elemSize) const
+    {
+        std::size_t recordBytes = 0;
+        for (const auto & block : blocks) recordBytes += block.second * elemSize;
+        if (format_ == SnapshotFormat::Raw) return config_.expectedRecords * recordBytes;
+
+        recordBytes += sizeof(snapfmt::RecordHeader) + blocks.size() * sizeof(std::uint64_t);
+        return sizeof(snapfmt::FileHeader) + blocks.size() * sizeof(snapfmt::BlockInfo)
+            + config_.expectedRecords * (recordBytes + sizeof(snapfmt::IndexEntry))
+            + sizeof(snapfmt::IndexFooter);
+    }
+
+    // double blocks converted into one reused float buffer
+    const std::vector<std::pair<const char *, std::size_t>> &
+    narrow(const std::vector<std::pair<const char *, std::size_t>> & blocks)
+    {
+        std::size_t total = 0;
+        for (const auto & block : blocks) total += block.second;
+        narrowData_.resize(total);
+
+        narrowBlocks_.resize(blocks.size());
+        std::size_t pos = 0;
+        for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+            const auto length = static_cast<Eigen::Index>(blocks[blockIdx].second);
+            Eigen::Map<Eigen::VectorXf>(narrowData_.data() + pos, length) =
+                Eigen::Map<const Eigen::VectorXd>(reinterpret_cast<const double *>(blocks[blockIdx].first), length).cast<float>();
+            narrowBlocks_[blockIdx] = {reinterpret_cast<const char *>(narrowData_.data() + pos), blocks[blockIdx].second};
+            pos += blocks[blockIdx].second;
+        }
+        return narrowBlocks_;
+    }
+
+    // blocks copied into one reused buffer, each cell-interleaved block reordered into nvars contiguous chunks
+    const std::vector<std::pair<const char *, std::size_t>> &
+    to_variable_major(const std::vector<std::pair<const char *, std::size_t>> & blocks, std::size_t elemSize)
+    {
+        if (blocks.size() != nvarsVec_.size()) {
+            throw std::runtime_error("SnapshotFileWriter: expected " + std::to_string(nvarsVec_.size()) + " blocks");
+        }
+        std::size_t total = 0;
+        for (const auto & block : blocks) total += block.second * elemSize;
+        transposedData_.resize(total);
+
+        transposedBlocks_.resize(blocks.size());
+        std::size_t pos = 0;
+        for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+            const auto length = blocks[blockIdx].second;
+            const auto nvars = static_cast<std::size_t>(nvarsVec_[blockIdx]);
+            if (length % nvars != 0) {
+                throw std::runtime_error("SnapshotFileWriter: block length is not a multiple of " + std::to_string(nvars));
+            }
+            char * dst = transposedData_.data() + pos;
+            if (elemSize == sizeof(double)) transpose_cells<double>(blocks[blockIdx].first, dst, length / nvars, nvars);
+            else                            transpose_cells<float>(blocks[blockIdx].first, dst, length / nvars, nvars);
+            transposedBlocks_[blockIdx] = {dst, length};
+            pos += length * elemSize;
+        }
+        return transposedBlocks_;
+    }
+
+    template<class ScalarType>
+    static void transpose_cells(const char * src, char * dst, std::size_t ncells, std::size_t nvars)
+    {
+        using mat_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, Eigen::Dynamic>;
+        const auto rows = static_cast<Eigen::Index>(nvars);
+        const auto cols = static_cast<Eigen::Index>(ncells);
+        Eigen::Map<mat_t>(reinterpret_cast<ScalarType *>(dst), cols, rows) =
+            Eigen::Map<const mat_t>(reinterpret_cast<const ScalarType *>(src), rows, cols).transpose();
+    }
+
+    void report_error_bounds() const
+    {
+        if (codec_ != SnapshotCodecType::Lossy) return;
+        std::cout << fileName_ << ": achieved max abs error per variable";
+        for (std::size_t blockIdx = 0; blockIdx < encoders_.size(); ++blockIdx) {
+            if (encoders_.size() > 1) std::cout << "\n  block " << blockIdx << ":";
+            for (const auto err : encoders_[blockIdx]->maxError()) std::cout << " " << err;
+        }
+        std::cout << std::endl;
+    }
+
+    void write_header(const std::vector<std::pair<const char *, std::size_t>> & blocks,
+                      std::size_t elemSize)
+    {
+        if (blocks.size() != nvarsVec_.size()) {
+            throw std::runtime_error("SnapshotFileWriter: expected " + std::to_string(nvarsVec_.size()) + " blocks");
+        }
+
+        std::vector<char> head;
+        snapfmt::FileHeader header = {{}, snapfmt::version, snapfmt::dtype_of_size(elemSize),
+            static_cast<std::uint32_t>(codec_), static_cast<std::uint32_t>(config_.layout),
+            blocks.size(), static_cast<std::uint64_t>(sampleFreq_), dt_};
+        std::memcpy(header.magic, snapfmt::headerMagic, 8);
+        snapfmt::append_bytes(head, header);
+        for (std::size_t blockIdx = 0; blockIdx < blocks.size(); ++blockIdx) {
+            lengths_.push_back(blocks[blockIdx].second);
+            snapfmt::BlockInfo info = {blocks[blockIdx].second, static_cast<std::uint64_t>(nvarsVec_[blockIdx])};
+            snapfmt::append_bytes(head, info);
+            if (codec_ != SnapshotCodecType::None) {
+                encoders_.push_back(create_snapshot_encoder(codec_, nvarsVec_[blockIdx],
+                    config_.errorBound, config_.errorBoundMode));
+            }
+        }
+        blockSizes_.resize(blocks.size());
+        emit(head.data(), head.size());
+        offset_ = head.size();
+        headerWritten_ = true;
+    }
+
+    std::string fileName_;
+    std::shared_ptr<AsyncWriter> writer_;
+    std::unique_ptr<ByteSink> sink_;
+    SnapshotConfig config_ = {};
+    SnapshotFormat format_ = SnapshotFormat::Raw;
+    SnapshotCodecType codec_ = SnapshotCodecType::None;
+    std::size_t keyframeInterval_ = 0;
+    std::vector<int> nvarsVec_;
+    int sampleFreq_ = {};
+    double dt_ = {};
+
+    bool headerWritten_ = false;
+    bool closed_ = false;
+    bool forceKeyframe_ = false;
+    std::vector<char> batch_;
+    std::size_t batchCount_ = 0;
+    std::vector<std::size_t> lengths_;
+    std::uint64_t offset_ = 0;
+    std::vector<snapfmt::IndexEntry> index_;
+    std::vector<std::unique_ptr<SnapshotEncoder>> encoders_;
+    std::vector<std::size_t> blockSizes_;
+    std::vector<char> encoded_;
+    std::vector<char> record_;
+    std::vector<float> narrowData_;
+    std::vector<std::pair<const char *, std::size_t>> narrowBlocks_;
+    std::vector<char> transposedData_;
+    std::vector<std::pair<const char *, std::size_t>> transposedBlocks_;
+};
+
+// Memory-mapped, read-only view of an indexed snapshot file.
+// Compressed files are decoded through read(), which streams forward from the nearest keyframe.
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(const std::string & f0)
+        : fileName_(f0)
+    {
+        fd_ = ::open(f0.c_str(), O_RDONLY);
+        if (fd_ < 0) throw std::runtime_error("SnapshotReader: could not open " + f0);
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("SnapshotReader: could not stat " + f0);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ < sizeof(snapfmt::FileHeader)) {
+            ::close(fd_);
+            throw std::runtime_error("SnapshotReader: " + f0 + " is not an indexed snapshot file");
+        }
+        void * addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("SnapshotReader: could not map " + f0);
+        }
+        base_ = static_cast<const char *>(addr);
+
+        try {
+            parse();
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader & operator=(const SnapshotReader &) = delete;
+
+    ~SnapshotReader() { release(); }
+
+    std::size_t numSnapshots()              const { return index_.size(); }
+    std::size_t numBlocks()                 const { return blocks_.size(); }
+    std::size_t vectorLength(std::size_t b = 0) const { return blocks_.at(b).length; }
+    std::size_t nvars(std::size_t b = 0)    const { return blocks_.at(b).nvars; }
+    std::size_t scalarSize()                const { return snapfmt::size_of_dtype(header_.dtype); }
+    int sampleFreq()                        const { return static_cast<int>(header_.sampleFreq); }
+    double dt()                             const { return header_.dt; }
+    std::int64_t step(std::size_t k)        const { return index_.at(k).step; }
+    double time(std::size_t k)              const { return index_.at(k).time; }
+
+    // raw bytes of block b of snapshot k
+    const char * blockBytes(std::size_t k, std::size_t b = 0) const
+    {
+        const char * rec = base_ + index_.at(k).offset + sizeof(snapfmt::RecordHeader);
+        std::uint64_t skip = blocks_.size() * sizeof(std::uint64_t);
+        for (std::size_t blockIdx = 0; blockIdx < b; ++blockIdx) {
+            std::uint64_t nbytes;
+            std::memcpy(&nbytes, rec + blockIdx * sizeof(std::uint64_t), sizeof(nbytes));
+            skip += nbytes;
+        }
+        return rec + skip;
+    }
+
+    // typed view of block b of snapshot k, no copy
+    template<class ScalarType>
+    const ScalarType * snapshot(std::size_t k, std::size_t b = 0) const
+    {
+        if ((sizeof(ScalarType) != scalarSize()) || (header_.codec != 0) || (header_.layout != 0)) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " cannot be viewed as the requested type");
+        }
+        return reinterpret_cast<const ScalarType *>(blockBytes(k, b));
+    }
+
+    std::size_t blockNumBytes(std::size_t k, std::size_t b = 0) const
+    {
+        std::uint64_t nbytes;
+        std::memcpy(&nbytes, base_ + index_.at(k).offset + sizeof(snapfmt::RecordHeader) + b * sizeof(std::uint64_t), sizeof(nbytes));
+        return nbytes;
+    }
+
+    bool isKeyframe(std::size_t k) const
+    {
+        snapfmt::RecordHeader rec;
+        std::memcpy(&rec, base_ + index_.at(k).offset, sizeof(rec));
+        return (rec.flags & snapfmt::RecordFlags::Keyframe) != 0;
+    }
+
+    SnapshotCodecType codec() const { return static_cast<SnapshotCodecType>(header_.codec); }
+    SnapshotLayout layout()   const { return static_cast<SnapshotLayout>(header_.layout); }
+
+    // typed view of one variable of block b of snapshot k, no copy; variable-major files only
+    template<class ScalarType>
+    const ScalarType * variable(std::size_t k, std::size_t var, std::size_t b = 0) const
+    {
+        if ((sizeof(ScalarType) != scalarSize()) || (header_.codec != 0) || (layout() != SnapshotLayout::VariableMajor)) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " has no contiguous variables of the requested type");
+        }
+        if (var >= nvars(b)) throw std::runtime_error("SnapshotReader: no variable " + std::to_string(var));
+        return reinterpret_cast<const ScalarType *>(blockBytes(k, b)) + var * (vectorLength(b) / nvars(b));
+    }
+
+    // copy of block b of snapshot k, decoded if necessary and always cell-interleaved;
+    // sequential k is O(1) per call
+    template<class ScalarType>
+    void read(std::size_t k, ScalarType * out, std::size_t b = 0)
+    {
+        if (sizeof(ScalarType) != scalarSize()) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " does not store the requested type");
+        }
+        const std::size_t nbytes = vectorLength(b) * sizeof(ScalarType);
+        if ((header_.codec == 0) && (layout() == SnapshotLayout::VariableMajor)) {
+            using mat_t = Eigen::Matrix<ScalarType, Eigen::Dynamic, Eigen::Dynamic>;
+            const auto nvarsIdx = static_cast<Eigen::Index>(nvars(b));
+            const auto ncells = static_cast<Eigen::Index>(vectorLength(b) / nvars(b));
+            Eigen::Map<mat_t>(out, nvarsIdx, ncells) =
+                Eigen::Map<const mat_t>(reinterpret_cast<const ScalarType *>(blockBytes(k, b)), ncells, nvarsIdx).transpose();
+            return;
+        }
+        if (header_.codec == 0) {
+            std::memcpy(out, blockBytes(k, b), nbytes);
+            return;
+        }
+
+        if (decoders_.empty()) {
+            for (std::size_t blockIdx = 0; blockIdx < blocks_.size(); ++blockIdx) {
+                decoders_.push_back(create_snapshot_decoder(codec()));
+            }
+            lastDecoded_.assign(blocks_.size(), -1);
+        }
+
+        // restart from the closest keyframe unless k directly follows the last decoded record
+        std::size_t first = k;
+        if (!(isKeyframe(k) || (lastDecoded_[b] == static_cast<long>(k) - 1))) {
+            while ((first > 0) && !isKeyframe(first)) --first;
+            if (!isKeyframe(first)) throw std::runtime_error("SnapshotReader: no keyframe before record " + std::to_string(k));
+        }
+        for (std::size_t rec = first; rec < k; ++rec) {
+            scratch_.resize(nbytes);
+            decoders_[b]->decode(blockBytes(rec, b), blockNumBytes(rec, b), vectorLength(b),
+                scalarSize(), isKeyframe(rec), scratch_.data());
+        }
+        decoders_[b]->decode(blockBytes(k, b), blockNumBytes(k, b), vectorLength(b),
+            scalarSize(), isKeyframe(k), reinterpret_cast<char *>(out));
+        lastDecoded_[b] = static_cast<long>(k);
+    }
+
+    // largest pointwise error per variable of block b over the whole file, lossy codec only
+    std::vector<double> achievedError(std::size_t b = 0) const
+    {
+        if (codec() != SnapshotCodecType::Lossy) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " is not lossy-compressed");
+        }
+        std::vector<double> err(nvars(b), 0.0);
+        for (std::size_t k = 0; k < numSnapshots(); ++k) {
+            const auto recErr = LossyQuantizeDecoder::block_max_error(blockBytes(k, b), blockNumBytes(k, b));
+            for (std::size_t var = 0; var < std::min(err.size(), recErr.size()); ++var) {
+                err[var] = std::max(err[var], recErr[var]);
+            }
+        }
+        return err;
+    }
+
+    // record holding the requested step, -1 if absent
+    long findStep(std::int64_t stepIn) const
+    {
+        std::size_t lo = 0, hi = index_.size();
+        while (lo < hi) {
+            const auto mid = (lo + hi) / 2;
+            if (index_[mid].step < stepIn) lo = mid + 1;
+            else hi = mid;
+        }
+        if ((lo < index_.size()) && (index_[lo].step == stepIn)) return static_cast<long>(lo);
+        return -1;
+    }
+
+private:
+    void parse()
+    {
+        std::memcpy(&header_, base_, sizeof(header_));
+        if (std::memcmp(header_.magic, snapfmt::headerMagic, 8) != 0) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " is not an indexed snapshot file");
+        }
+        if (header_.version > snapfmt::version) {
+            throw std::runtime_error("SnapshotReader: unsupported version " + std::to_string(header_.version));
+        }
+        if (header_.layout > static_cast<std::uint32_t>(SnapshotLayout::VariableMajor)) {
+            throw std::runtime_error("SnapshotReader: unsupported layout " + std::to_string(header_.layout));
+        }
+
+        // a corrupt count must not size the block table past the end of the file
+        if (header_.numBlocks > (size_ - sizeof(header_)) / sizeof(snapfmt::BlockInfo)) {
+            throw std::runtime_error("SnapshotReader: " + fileName_ + " is truncated or corrupt, "
+                + std::to_string(header_.numBlocks) + " blocks do not fit in the file");
+        }
+
+        std::size_t pos = sizeof(header_);
+        blocks_.resize(header_.numBlocks);
+        for (auto & block : blocks_) {
+            std::memcpy(&block, base_ + pos, sizeof(block));
+            pos += sizeof(block);
+        }
+        const std::size_t firstRecord = pos;
+
+        // index from the footer if the writer finished cleanly
+        snapfmt::IndexFooter footer;
+        if (size_ >= firstRecord + sizeof(footer)) {
+            std::memcpy(&footer, base_ + size_ - sizeof(footer), sizeof(footer));
+            if ((std::memcmp(footer.magic, snapfmt::indexMagic, 8) == 0) &&
+                (footer.indexOffset >= firstRecord) && (footer.indexOffset <= size_ - sizeof(footer)) &&
+                (footer.numRecords == (size_ - sizeof(footer) - footer.indexOffset) / sizeof(snapfmt::IndexEntry)) &&
+                (footer.indexOffset + footer.numRecords * sizeof(snapfmt::IndexEntry) + sizeof(footer) == size_))
+            {
+                index_.resize(footer.numRecords);
+                std::memcpy(index_.data(), base_ + footer.indexOffset, footer.numRecords * sizeof(snapfmt::IndexEntry));
+                return;
+            }
+        }
+
+        // otherwise walk the records, up to the end marker of an untrimmed preallocated file
+        // or the first record that is torn or not a record at all
+        std::vector<std::uint64_t> storedSizes;
+        if (header_.codec == 0) {
+            for (const auto & block : blocks_) storedSizes.push_back(block.length * scalarSize());
+        }
+        std::int64_t prevStep = std::numeric_limits<std::int64_t>::min();
+        while (pos + sizeof(snapfmt::RecordHeader) <= size_) {
+            if (std::memcmp(base_ + pos, MappedSink::endMarker, sizeof(MappedSink::endMarker)) == 0) break;
+            snapfmt::RecordHeader rec;
+            std::memcpy(&rec, base_ + pos, sizeof(rec));
+            if (!snapfmt::record_fits(rec, prevStep, blocks_.size(), size_ - pos) ||
+                !snapfmt::record_blocks_match(rec, base_ + pos + sizeof(rec), blocks_.size(), storedSizes)) {
+                break;
+            }
+            index_.push_back({rec.step, rec.time, pos});
+            prevStep = rec.step;
+            pos += sizeof(rec) + rec.nbytes;
+        }
+    }
+
+    void release()
+    {
+        if (base_) ::munmap(const_cast<char *>(base_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+    std::string fileName_;
+    int fd_ = -1;
+    std::size_t size_ = 0;
+    const char * base_ = nullptr;
+    snapfmt::FileHeader header_ = {};
+    std::vector<snapfmt::BlockInfo> blocks_;
+    std::vector<snapfmt::IndexEntry> index_;
+
+    std::vector<std::unique_ptr<SnapshotDecoder>> decoders_;
+    std::vector<long> lastDecoded_;
+    std::vector<char> scratch_;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef PDAS_EXPERIMENTS_SOLVER_TELEMETRY_HPP_
+#define PDAS_EXPERIMENTS_SOLVER_TELEMETRY_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "perf_counters.hpp"
+
+// what the nonlinear solver did during one time step, gathered from its linear solves
+struct SolverStepStats
+{
+    std::uint32_t nonlinearIters = 0;   // one linear solve per Newton / Gauss-Newton iteration
+    std::uint32_t linearItersTotal = 0; // iterative linear solvers only, 0 otherwise
+    std::uint32_t linearItersMax = 0;
+    double rhsNormFirst = 0.0;          // Newton: residual, Gauss-Newton: gradient J^T r
+    double rhsNormLast = 0.0;
+    double correctionNormLast = 0.0;
+    double linearSeconds = 0.0;
+    double residualSeconds = 0.0;       // residual-only evaluations, with a ProfiledSystem given these stats
+    double jacobianSeconds = 0.0;       // evaluations assembling the Jacobian, fused residuals included
+    double stepSeconds = 0.0;           // the whole step's nonlinear solve
+};
+
+namespace telemetry_impl {
+
+template<class T, class = void>
+struct has_iteration_count : std::false_type {};
+
+template<class T>
+struct has_iteration_count<T, std::void_t<decltype(std::declval<const T &>().numIterationsExecuted())>>
+    : std::true_type {};
+
+// the nested types pressio looks up on a system, declared only where the wrapped system has them
+template<class T, class = void> struct system_scalar_type {};
+template<class T> struct system_scalar_type<T, std::void_t<typename T::scalar_type>>
+    { using scalar_type = typename T::scalar_type; };
+template<class T, class = void> struct system_time_type {};
+template<class T> struct system_time_type<T, std::void_t<typename T::time_type>>
+    { using time_type = typename T::time_type; };
+template<class T, class = void> struct system_independent_variable_type {};
+template<class T> struct system_independent_variable_type<T, std::void_t<typename T::independent_variable_type>>
+    { using independent_variable_type = typename T::independent_variable_type; };
+template<class T, class = void> struct system_state_type {};
+template<class T> struct system_state_type<T, std::void_t<typename T::state_type>>
+    { using state_type = typename T::state_type; };
+template<class T, class = void> struct system_rhs_type {};
+template<class T> struct system_rhs_type<T, std::void_t<typename T::rhs_type>>
+    { using rhs_type = typename T::rhs_type; };
+template<class T, class = void> struct system_jacobian_type {};
+template<class T> struct system_jacobian_type<T, std::void_t<typename T::jacobian_type>>
+    { using jacobian_type = typename T::jacobian_type; };
+
+// whether a fused residual and Jacobian call asks for the Jacobian
+template<class T>
+bool jacobian_requested(const std::optional<T *> & jacobian) { return jacobian.has_value() && (*jacobian != nullptr); }
+
+template<class T>
+bool jacobian_requested(const T &) { return true; }
+
+// adds the wall time from construction to destruction to *seconds, unless seconds is null
+class AssemblyTimer
+{
+public:
+    explicit AssemblyTimer(double * seconds) : seconds_(seconds)
+    {
+        if (seconds_ != nullptr) start_ = std::chrono::high_resolution_clock::now();
+    }
+
+    AssemblyTimer(const AssemblyTimer &) = delete;
+    AssemblyTimer & operator=(const AssemblyTimer &) = delete;
+
+    ~AssemblyTimer()
+    {
+        if (seconds_ == nullptr) return;
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start_;
+        *seconds_ += elapsed.count();
+    }
+
+private:
+    double * seconds_;
+    std::chrono::high_resolution_clock::time_point start_;
+};
+
+} // namespace telemetry_impl
+
+/*
+    System handed to pressio in place of a pressio-demoapps problem, counting its residual and
+    Jacobian evaluations under the "residual", "jacobian" and (fused) "residualJacobian" phases of
+    perfCountersFile. Every call is forwarded; members the problem lacks drop out of overload resolution,
+    so pressio sees the same system concept. Given stats, their residual and Jacobian seconds add up the
+    wall time of those calls. Holds references, the problem and stats must outlive it.
+*/
+template<class SystemType>
+class ProfiledSystem
+    : public telemetry_impl::system_scalar_type<SystemType>,
+      public telemetry_impl::system_time_type<SystemType>,
+      public telemetry_impl::system_independent_variable_type<SystemType>,
+      public telemetry_impl::system_state_type<SystemType>,
+      public telemetry_impl::system_rhs_type<SystemType>,
+      public telemetry_impl::system_jacobian_type<SystemType>
+{
+public:
+    explicit ProfiledSystem(const SystemType & system, SolverStepStats * stats = nullptr)
+        : system_(system), stats_(stats) {}
+
+    template<class... Args, class S = SystemType>
+    auto createState(Args &&... args) const -> decltype(std::declval<const S &>().createState(std::forward<Args>(args)...))
+    { return system_.createState(std::forward<Args>(args)...); }
+
+    template<class... Args, class S = SystemType>
+    auto createRhs(Args &&... args) const -> decltype(std::declval<const S &>().createRhs(std::forward<Args>(args)...))
+    { return system_.createRhs(std::forward<Args>(args)...); }
+
+    template<class... Args, class S = SystemType>
+    auto createJacobian(Args &&... args) const -> decltype(std::declval<const S &>().createJacobian(std::forward<Args>(args)...))
+    { return system_.createJacobian(std::forward<Args>(args)...); }
+
+    template<class... Args, class S = SystemType>
+    auto createResultOfJacobianActionOn(Args &&... args) const
+        -> decltype(std::declval<const S &>().createResultOfJacobianActionOn(std::forward<Args>(args)...))
+    { return system_.createResultOfJacobianActionOn(std::forward<Args>(args)...); }
+
+    template<class... Args, class S = SystemType>
+    auto rhs(Args &&... args) const -> decltype(std::declval<const S &>().rhs(std::forward<Args>(args)...))
+    {
+        PerfScope scope("residual");
+        telemetry_impl::AssemblyTimer timer(seconds(false));
+        return system_.rhs(std::forward<Args>(args)...);
+    }
+
+    template<class... Args, class S = SystemType>
+    auto jacobian(Args &&... args) const -> decltype(std::declval<const S &>().jacobian(std::forward<Args>(args)...))
+    {
+        PerfScope scope("jacobian");
+        telemetry_impl::AssemblyTimer timer(seconds(true));
+        return system_.jacobian(std::forward<Args>(args)...);
+    }
+
+    template<class... Args, class S = SystemType>
+    auto applyJacobian(Args &&... args) const -> decltype(std::declval<const S &>().applyJacobian(std::forward<Args>(args)...))
+    {
+        PerfScope scope("jacobian");
+        telemetry_impl::AssemblyTimer timer(seconds(true));
+        return system_.applyJacobian(std::forward<Args>(args)...);
+    }
+
+    template<class StateType, class TimeType, class RhsType, class JacobianType, class S = SystemType>
+    auto rhsAndJacobian(const StateType & state, const TimeType & time, RhsType & rhs, JacobianType && jacobian) const
+        -> decltype(std::declval<const S &>().rhsAndJacobian(state, time, rhs, std::forward<JacobianType>(jacobian)))
+    {
+        const bool withJacobian = telemetry_impl::jacobian_requested(jacobian);
+        PerfScope scope(withJacobian ? "residualJacobian" : "residual");
+        telemetry_impl::AssemblyTimer timer(seconds(withJacobian));
+        return system_.rhsAndJacobian(state, time, rhs, std::forward<JacobianType>(jacobian));
+    }
+
+    const SystemType & system() const { return system_; }
+
+private:
+    double * seconds(bool jacobian) const
+    {
+        if (stats_ == nullptr) return nullptr;
+        return jacobian ? &stats_->jacobianSeconds : &stats_->residualSeconds;
+    }
+
+    const SystemType & system_;
+    SolverStepStats * stats_;
+};
+
+// Linear solver handed to the pressio nonlinear solver in place of LinearSolverType,
+// recording each solve into stats() before forwarding it
+template<class LinearSolverType>
+class TelemetryLinearSolver
+{
+public:
+    using matrix_type = typename LinearSolverType::matrix_type;
+
+    // pressio keeps a reference to the solver it is given, so stats() sees every solve
+    TelemetryLinearSolver() = default;
+
+    template<class MatrixType, class RhsType, class SolutionType>
+    void solve(const MatrixType & A, const RhsType & b, SolutionType & x)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        {
+            PerfScope scope("linearSolve");
+            solver_.solve(A, b, x);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        stats_.nonlinearIters += 1;
+        stats_.linearSeconds += elapsed.count();
+        if constexpr (telemetry_impl::has_iteration_count<LinearSolverType>::value) {
+            const auto iters = static_cast<std::uint32_t>(solver_.numIterationsExecuted());
+            stats_.linearItersTotal += iters;
+            stats_.linearItersMax = std::max(stats_.linearItersMax, iters);
+        }
+        stats_.rhsNormLast = b.norm();
+        if (stats_.nonlinearIters == 1) stats_.rhsNormFirst = stats_.rhsNormLast;
+        stats_.correctionNormLast = x.norm();
+    }
+
+    SolverStepStats & stats() { return stats_; }
+    LinearSolverType & solver() { return solver_; }
+
+private:
+    LinearSolverType solver_;
+    SolverStepStats stats_;
+};
+
+/*
+    Solver telemetry file:
+    header: char magic[8] "PDASSOLV", std::uint32_t version, std::uint32_t reserved
+    per step and block: std::int64_t step, std::uint32_t block, std::uint32_t nonlinearIters,
+        std::uint32_t linearItersTotal, std::uint32_t linearItersMax,
+        double rhsNormFirst, double rhsNormLast, double correctionNormLast, double linearSeconds,
+        double residualSeconds, double jacobianSeconds, double stepSeconds
+    block is 0 in monolithic runs; stepSeconds / nonlinearIters is the wall time per iteration.
+    Decomposed runs solve inside pda-schwarz, where only the controller is visible: they write one record
+    per step and subdomain (block), with the Schwarz subiterations, each one nonlinear solve of the
+    subdomain, as nonlinearIters, the controller step's wall time as stepSeconds, linear counts 0 and
+    NaN for the norms and the other times. Version 1 records end after linearSeconds.
+*/
+class SolverTelemetryObserver
+{
+public:
+    static constexpr char magic[8] = {'P', 'D', 'A', 'S', 'S', 'O', 'L', 'V'};
+    static constexpr std::uint32_t version = 2;
+
+    // an empty file name disables the observer; append continues the file of a restarted run
+    SolverTelemetryObserver(const std::string & f0, SolverStepStats & stats, bool append = false)
+        : fileName_(f0)
+    {
+        if (f0.empty()) return;
+        stats_ = &stats;
+        file_.open(f0, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+        if (!file_) throw std::runtime_error("Could not open " + f0);
+        if (append) {
+            std::ifstream fin(f0, std::ios::in | std::ios::binary);
+            char fileMagic[8] = {};
+            std::uint32_t fileVersion = 0;
+            fin.read(fileMagic, sizeof(fileMagic));
+            fin.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+            if (!fin || !std::equal(fileMagic, fileMagic + 8, magic) || (fileVersion != version)) {
+                throw std::runtime_error(f0 + " is not a version " + std::to_string(version)
+                    + " solver telemetry file, cannot append to it");
+            }
+            fin.seekg(0, std::ios::end);
+            size_ = static_cast<std::uint64_t>(fin.tellg());
+            return;
+        }
+        const std::uint32_t head[2] = {version, 0};
+        file_.write(magic, sizeof(magic));
+        file_.write(reinterpret_cast<const char*>(head), sizeof(head));
+        size_ = sizeof(magic) + sizeof(head);
+    }
+
+    template<typename TimeType, typename ObservableType>
+    void operator()(pressio::ode::StepCount step, const TimeType /*timeIn*/, const ObservableType & /*state*/)
+    {
+        if (stats_ == nullptr) return;
+        // step 0 is the initial condition, nothing solved yet
+        if (step.get() > 0) write(step.get(), 0, *stats_);
+        *stats_ = SolverStepStats();
+    }
+
+    void write(std::int64_t step, std::uint32_t block, const SolverStepStats & stats)
+    {
+        const std::uint32_t counts[4] = {block, stats.nonlinearIters, stats.linearItersTotal, stats.linearItersMax};
+        const double values[7] = {stats.rhsNormFirst, stats.rhsNormLast, stats.correctionNormLast, stats.linearSeconds,
+            stats.residualSeconds, stats.jacobianSeconds, stats.stepSeconds};
+        file_.write(reinterpret_cast<const char*>(&step), sizeof(std::int64_t));
+        file_.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+        file_.write(reinterpret_cast<const char*>(values), sizeof(values));
+        size_ += sizeof(std::int64_t) + sizeof(counts) + sizeof(values);
+    }
+
+    bool enabled() const { return stats_ != nullptr; }
+
+    void flush() { file_.flush(); }
+
+    const std::string & fileName() const { return fileName_; }
+
+    std::uint64_t size() const { return size_; }
+
+private:
+    std::string fileName_;
+    SolverStepStats * stats_ = nullptr;
+    std::ofstream file_;
+    std::uint64_t size_ = 0;
+};
+
+#endif
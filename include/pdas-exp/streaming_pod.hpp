@@ -0,0 +1,211 @@
+#ifndef PDAS_EXPERIMENTS_STREAMING_POD_HPP_
+#define PDAS_EXPERIMENTS_STREAMING_POD_HPP_
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <Eigen/Dense>
+
+enum class PodCenterMethod { None, Init, Mean };
+
+inline PodCenterMethod string_to_pod_center(const std::string & strIn)
+{
+    if      (strIn == "none") { return PodCenterMethod::None; }
+    else if (strIn == "init") { return PodCenterMethod::Init; }
+    else if (strIn == "mean") { return PodCenterMethod::Mean; }
+    else {
+        throw std::runtime_error("string_to_pod_center: Invalid pod center " + strIn);
+    }
+}
+
+// In-situ POD settings, the "pod" block of the input file
+struct PodConfig
+{
+    bool enabled = false;
+    int sampleFreq = 1;
+    PodCenterMethod center = PodCenterMethod::Mean;
+    double energy = 1.0;    // fraction of the (centered) snapshot energy to retain
+    int maxModes  = 0;      // cap on the working rank, 0: no cap
+    int batchSize = 8;      // snapshots per SVD update
+    std::string basisFile  = "basis.bin";
+    std::string centerFile = "center.bin";
+};
+
+// same layout read by pdaschwarz::read_matrix_from_binary / read_vector_from_binary:
+// std::size_t rows, std::size_t cols, column-major data
+template<class MatrixType>
+void write_matrix_to_binary(const std::string & fileName, const MatrixType & mat)
+{
+    using scalar_t = typename MatrixType::Scalar;
+    std::ofstream fout(fileName, std::ios::out | std::ios::binary);
+    if (!fout) throw std::runtime_error("Could not open " + fileName);
+
+    const std::size_t rows = mat.rows();
+    const std::size_t cols = mat.cols();
+    const Eigen::Matrix<scalar_t, -1, -1> dense = mat;
+    fout.write(reinterpret_cast<const char*>(&rows), sizeof(std::size_t));
+    fout.write(reinterpret_cast<const char*>(&cols), sizeof(std::size_t));
+    fout.write(reinterpret_cast<const char*>(dense.data()), rows * cols * sizeof(scalar_t));
+    if (!fout) throw std::runtime_error("Failed writing to " + fileName);
+}
+
+/*
+    Incremental thin SVD of a snapshot matrix that arrives a batch of columns at a time
+    (Brand 2006), with the running-mean correction of Ross et al. 2008 for mean centering.
+    Without truncation the result matches the SVD of the full centered snapshot matrix.
+*/
+class StreamingPod
+{
+public:
+    using matrix_t = Eigen::MatrixXd;
+    using vector_t = Eigen::VectorXd;
+
+    StreamingPod() = default;
+
+    StreamingPod(PodCenterMethod center, int maxModes)
+        : centerMethod_(center), maxModes_(maxModes){}
+
+    // columns of batch are raw (uncentered) snapshots
+    void update(const matrix_t & batch)
+    {
+        const auto nsnaps = batch.cols();
+        if (nsnaps == 0) return;
+
+        if (numSnapshots_ == 0) {
+            center_ = vector_t::Zero(batch.rows());
+            if (centerMethod_ == PodCenterMethod::Init) center_ = batch.col(0);
+        }
+        else if (batch.rows() != center_.size()) {
+            throw std::runtime_error("StreamingPod: snapshot length changed");
+        }
+
+        // centered columns; for the running mean, one extra column carries the shift of the mean
+        matrix_t cols;
+        if (centerMethod_ == PodCenterMethod::Mean) {
+            const vector_t batchMean = batch.rowwise().mean();
+            const double nOld = static_cast<double>(numSnapshots_);
+            const double nNew = static_cast<double>(nsnaps);
+            cols.resize(batch.rows(), nsnaps + (numSnapshots_ > 0 ? 1 : 0));
+            cols.leftCols(nsnaps) = batch.colwise() - batchMean;
+            if (numSnapshots_ > 0) {
+                cols.col(nsnaps) = std::sqrt(nOld * nNew / (nOld + nNew)) * (batchMean - center_);
+            }
+            center_ = (nOld * center_ + nNew * batchMean) / (nOld + nNew);
+        }
+        else {
+            cols = batch.colwise() - center_;
+        }
+
+        numSnapshots_ += nsnaps;
+        totalEnergy_ += cols.squaredNorm();
+        add_columns(cols);
+    }
+
+    // smallest basis retaining the requested energy fraction, relative to all data seen
+    int modes_for_energy(double energy) const
+    {
+        if (energy >= 1.0) return static_cast<int>(sigma_.size());
+        double cumulative = 0.0;
+        for (int modeIdx = 0; modeIdx < sigma_.size(); ++modeIdx) {
+            cumulative += sigma_(modeIdx) * sigma_(modeIdx);
+            if (cumulative >= energy * totalEnergy_) return modeIdx + 1;
+        }
+        return static_cast<int>(sigma_.size());
+    }
+
+    double energy_fraction(int numModes) const
+    {
+        if (totalEnergy_ <= 0.0) return 1.0;
+        return sigma_.head(numModes).squaredNorm() / totalEnergy_;
+    }
+
+    const matrix_t & basis()          const { return basis_; }
+    const vector_t & singularValues() const { return sigma_; }
+    const vector_t & center()         const { return center_; }
+    std::size_t numSnapshots()        const { return numSnapshots_; }
+
+private:
+    void add_columns(const matrix_t & cols)
+    {
+        const auto nrows = cols.rows();
+        const auto ncols = cols.cols();
+        const auto rank  = sigma_.size();
+
+        if (rank == 0) {
+            Eigen::BDCSVD<matrix_t> svd(cols, Eigen::ComputeThinU);
+            basis_ = svd.matrixU();
+            sigma_ = svd.singularValues();
+            truncate();
+            return;
+        }
+
+        // project out the current basis, twice to keep the new directions orthogonal to it
+        matrix_t proj = basis_.transpose() * cols;
+        matrix_t resid = cols - basis_ * proj;
+        const matrix_t proj2 = basis_.transpose() * resid;
+        resid -= basis_ * proj2;
+        proj += proj2;
+
+        Eigen::HouseholderQR<matrix_t> qr(resid);
+        const matrix_t qmat = qr.householderQ() * matrix_t::Identity(nrows, ncols);
+        const matrix_t rmat = qr.matrixQR().topRows(ncols).template triangularView<Eigen::Upper>();
+
+        // [diag(S) proj; 0 R] is small, its SVD rotates [U Q] onto the updated basis
+        matrix_t middle = matrix_t::Zero(rank + ncols, rank + ncols);
+        middle.topLeftCorner(rank, rank) = sigma_.asDiagonal();
+        middle.topRightCorner(rank, ncols) = proj;
+        middle.bottomRightCorner(ncols, ncols) = rmat;
+        Eigen::JacobiSVD<matrix_t> svd(middle, Eigen::ComputeThinU);
+
+        matrix_t extended(nrows, rank + ncols);
+        extended << basis_, qmat;
+        basis_ = extended * svd.matrixU();
+        sigma_ = svd.singularValues();
+        truncate();
+
+        if (++numUpdates_ % reorthInterval_ == 0) reorthogonalize();
+    }
+
+    // drop numerically zero directions and anything past the rank cap
+    void truncate()
+    {
+        const double tol = (sigma_.size() > 0)
+            ? sigma_(0) * std::numeric_limits<double>::epsilon() * std::sqrt(static_cast<double>(basis_.rows()))
+            : 0.0;
+        int rank = 0;
+        while ((rank < sigma_.size()) && (sigma_(rank) > tol)) ++rank;
+        if ((maxModes_ > 0) && (rank > maxModes_)) rank = maxModes_;
+
+        basis_ = basis_.leftCols(rank).eval();
+        sigma_ = sigma_.head(rank).eval();
+    }
+
+    // rounding slowly erodes orthogonality of the accumulated basis
+    void reorthogonalize()
+    {
+        Eigen::HouseholderQR<matrix_t> qr(basis_);
+        const auto rank = basis_.cols();
+        const matrix_t qmat = qr.householderQ() * matrix_t::Identity(basis_.rows(), rank);
+        const matrix_t rmat = qr.matrixQR().topRows(rank).template triangularView<Eigen::Upper>();
+        Eigen::JacobiSVD<matrix_t> svd(rmat * sigma_.asDiagonal(), Eigen::ComputeThinU);
+        basis_ = qmat * svd.matrixU();
+        sigma_ = svd.singularValues();
+    }
+
+    PodCenterMethod centerMethod_ = PodCenterMethod::Mean;
+    int maxModes_ = 0;
+    int reorthInterval_ = 32;
+
+    matrix_t basis_;
+    vector_t sigma_;
+    vector_t center_;
+    std::size_t numSnapshots_ = 0;
+    std::size_t numUpdates_ = 0;
+    double totalEnergy_ = 0.0;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef PDAS_EXPERIMENTS_SUBITERATIONS_HPP_
+#define PDAS_EXPERIMENTS_SUBITERATIONS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Schwarz subiterations, one record per outer step:
+    header: char magic[8] "PDASSUBI", std::uint32_t version, std::uint32_t numDomains,
+            double relTol, double absTol, std::int32_t convStepMax, std::uint32_t reserved
+    record: std::int64_t step, std::uint32_t numSubiters, std::uint32_t reserved
+
+    The interface norms checked against relTol/absTol between subiterations stay inside pda-schwarz's
+    controller, so this is a count log, not a convergence history: steps with numSubiters == convStepMax
+    are the ones stopped by the cap. Version 1 records also held each subdomain's full state change
+    over the step, which says nothing about interface convergence.
+    Records are kept in a buffer allocated up front and written when it fills, at checkpoints and by finalize().
+*/
+class SubiterationRecorder
+{
+public:
+    static constexpr char magic[8] = {'P', 'D', 'A', 'S', 'S', 'U', 'B', 'I'};
+    static constexpr std::uint32_t version = 2;
+
+    SubiterationRecorder() = default;
+
+    // an empty file name disables the recorder; append continues the file of a restarted run
+    SubiterationRecorder(const std::string & f0, int numDomains, double relTol, double absTol,
+                        int convStepMax, int bufferSteps, bool append = false)
+        : fileName_(f0), convStepMax_(std::max(convStepMax, 0)),
+        bufferSteps_(std::max(bufferSteps, 1))
+    {
+        if (f0.empty()) return;
+        enabled_ = true;
+        file_.open(f0, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+        if (!file_) throw std::runtime_error("Could not open " + f0);
+        if (append) {
+            std::ifstream fin(f0, std::ios::in | std::ios::binary);
+            char fileMagic[8] = {};
+            std::uint32_t fileVersion = 0;
+            fin.read(fileMagic, sizeof(fileMagic));
+            fin.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+            if (!fin || !std::equal(fileMagic, fileMagic + 8, magic) || (fileVersion != version)) {
+                throw std::runtime_error(f0 + " is not a version " + std::to_string(version)
+                    + " subiteration file, cannot append to it");
+            }
+            fin.seekg(0, std::ios::end);
+            size_ = static_cast<std::uint64_t>(fin.tellg());
+        }
+        else {
+            const std::uint32_t counts[2] = {version, static_cast<std::uint32_t>(numDomains)};
+            const double tols[2] = {relTol, absTol};
+            const std::int32_t stepMax = convStepMax_;
+            const std::uint32_t reserved = 0;
+            file_.write(magic, sizeof(magic));
+            file_.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+            file_.write(reinterpret_cast<const char*>(tols), sizeof(tols));
+            file_.write(reinterpret_cast<const char*>(&stepMax), sizeof(std::int32_t));
+            file_.write(reinterpret_cast<const char*>(&reserved), sizeof(std::uint32_t));
+            size_ = sizeof(magic) + sizeof(counts) + sizeof(tols) + sizeof(std::int32_t) + sizeof(std::uint32_t);
+        }
+
+        steps_.resize(bufferSteps_);
+        subiters_.resize(bufferSteps_);
+        iterCounts_.assign(convStepMax_ + 1, 0);
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // once per outer step
+    void commit(std::int64_t step, int numSubiters)
+    {
+        if (!enabled_) return;
+        steps_[count_] = step;
+        subiters_[count_] = static_cast<std::uint32_t>(numSubiters);
+        iterCounts_[std::min(std::max(numSubiters, 0), convStepMax_)] += 1;
+        totalSubiters_ += static_cast<std::uint64_t>(std::max(numSubiters, 0));
+        ++numRecords_;
+        if (++count_ == bufferSteps_) flush();
+    }
+
+    // writes the buffered records
+    void flush()
+    {
+        if (!enabled_) return;
+        const std::uint32_t reserved = 0;
+        for (int rowIdx = 0; rowIdx < count_; ++rowIdx) {
+            file_.write(reinterpret_cast<const char*>(&steps_[rowIdx]), sizeof(std::int64_t));
+            file_.write(reinterpret_cast<const char*>(&subiters_[rowIdx]), sizeof(std::uint32_t));
+            file_.write(reinterpret_cast<const char*>(&reserved), sizeof(std::uint32_t));
+        }
+        size_ += static_cast<std::uint64_t>(count_) * (sizeof(std::int64_t) + 2 * sizeof(std::uint32_t));
+        count_ = 0;
+        file_.flush();
+    }
+
+    void finalize()
+    {
+        if (!enabled_) return;
+        flush();
+        if (numRecords_ == 0) return;
+        std::cout << fileName_ << ": " << static_cast<double>(totalSubiters_) / numRecords_
+            << " Schwarz subiterations per step over " << numRecords_ << " steps, "
+            << iterCounts_[convStepMax_] << " stopped at convStepMax = " << convStepMax_ << std::endl;
+    }
+
+    const std::string & fileName() const { return fileName_; }
+
+    std::uint64_t size() const { return size_; }
+
+private:
+    bool enabled_ = false;
+    std::string fileName_;
+    std::ofstream file_;
+    int convStepMax_ = 0;
+    int bufferSteps_ = 1;
+    int count_ = 0;
+    std::uint64_t numRecords_ = 0;
+    std::uint64_t totalSubiters_ = 0;
+    std::uint64_t size_ = 0;
+    std::vector<std::int64_t> steps_;
+    std::vector<std::uint32_t> subiters_;
+    std::vector<std::uint64_t> iterCounts_;     // steps per subiteration count, the last one at or over the cap
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef PDAS_EXPERIMENTS_TIMERS_HPP_
+#define PDAS_EXPERIMENTS_TIMERS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Nested wall-clock timers over the whole run, e.g.
+
+        ScopedTimer timer("setup");
+        ...
+        timer.stop();   // or at end of scope
+
+    Each thread accumulates into its own tree, keyed by the names of the open timers, so timers
+    nest by scope and never contend. Disabled (the default) a timer is one relaxed atomic load.
+    With timersFile set in the input, the trees are written as JSON when the runner exits:
+
+    {"version": 1, "threads": [{"thread": 0, "timers": [
+        {"name": "setup", "calls": 1, "seconds": 1.2, "children": [...]}, ...]}, ...]}
+
+    Thread 0 is the main thread, worker threads follow in the order they first timed something.
+*/
+
+using timer_clock_t = std::chrono::high_resolution_clock;
+
+struct TimerNode
+{
+    std::string name;
+    TimerNode * parent = nullptr;
+    std::uint64_t calls = 0;
+    double seconds = 0.0;
+    std::vector<std::unique_ptr<TimerNode>> children;
+
+    TimerNode * child(const char * childName)
+    {
+        // a handful of children per node, a linear search beats hashing
+        for (auto & node : children) {
+            if (node->name == childName) return node.get();
+        }
+        children.emplace_back(new TimerNode{childName, this});
+        return children.back().get();
+    }
+};
+
+class TimerRegistry
+{
+public:
+    static TimerRegistry & instance()
+    {
+        static TimerRegistry registry;
+        return registry;
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void enable(const std::string & f0)
+    {
+        fileName_ = f0;
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    // the calling thread's open timer, its tree created on first use; trees outlive their threads
+    TimerNode *& current()
+    {
+        thread_local TimerNode * node = nullptr;
+        if (node == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            roots_.emplace_back(new TimerNode{"root"});
+            node = roots_.back().get();
+        }
+        return node;
+    }
+
+    // time measured by the caller, under the open timer; e.g. reading the input that enables the registry
+    void add(const char * name, double seconds)
+    {
+        if (!enabled()) return;
+        auto * node = current()->child(name);
+        node->calls += 1;
+        node->seconds += seconds;
+    }
+
+    // call with the worker threads idle, i.e. outside parallel regions
+    void write() const
+    {
+        if (!enabled()) return;
+        std::ofstream fout(fileName_);
+        if (!fout) throw std::runtime_error("Could not open " + fileName_);
+
+        fout << "{\"version\": 1, \"threads\": [";
+        for (std::size_t threadIdx = 0; threadIdx < roots_.size(); ++threadIdx) {
+            fout << (threadIdx ? ", " : "") << "{\"thread\": " << threadIdx << ", \"timers\": ";
+            write_children(fout, *roots_[threadIdx]);
+            fout << "}";
+        }
+        fout << "]}\n";
+    }
+
+private:
+    TimerRegistry() = default;
+
+    static void write_children(std::ofstream & fout, const TimerNode & node)
+    {
+        fout << "[";
+        for (std::size_t childIdx = 0; childIdx < node.children.size(); ++childIdx) {
+            const auto & child = *node.children[childIdx];
+            // timer names are identifiers, nothing to escape
+            fout << (childIdx ? ", " : "") << "{\"name\": \"" << child.name << "\", \"calls\": " << child.calls
+                << ", \"seconds\": " << child.seconds << ", \"children\": ";
+            write_children(fout, child);
+            fout << "}";
+        }
+        fout << "]";
+    }
+
+    std::atomic<bool> enabled_{false};
+    std::string fileName_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TimerNode>> roots_;
+};
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char * name)
+    {
+        auto & registry = TimerRegistry::instance();
+        if (!registry.enabled()) return;
+        auto *& current = registry.current();
+        node_ = current->child(name);
+        current = node_;
+        start_ = timer_clock_t::now();
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() { stop(); }
+
+    // ends the timer early, timers opened after it must already be stopped
+    void stop()
+    {
+        if (node_ == nullptr) return;
+        const std::chrono::duration<double> elapsed = timer_clock_t::now() - start_;
+        node_->calls += 1;
+        node_->seconds += elapsed.count();
+        TimerRegistry::instance().current() = node_->parent;
+        node_ = nullptr;
+    }
+
+private:
+    TimerNode * node_ = nullptr;
+    timer_clock_t::time_point start_;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef PDAS_EXPERIMENTS_TRACE_HPP_
+#define PDAS_EXPERIMENTS_TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+    Timeline of what each thread does, written as a Chrome trace (chrome://tracing, ui.perfetto.dev):
+
+    {"displayTimeUnit": "ms", "traceEvents": [
+        {"name": "thread_name", "ph": "M", "pid": 0, "tid": 1, "args": {"name": "thread 1"}}, ...
+        {"name": "controller", "ph": "X", "pid": 0, "tid": 1, "ts": 12.5, "dur": 3.25, "args": {"step": 4, "subiterations": 3}}, ...]}
+
+    ts and dur are microseconds since the recorder was enabled. Every thread appends to its own
+    buffer, so recording takes no lock; tid is the order in which threads first record, 0 being
+    the thread that enabled the recorder. Disabled (the default) an event is one relaxed atomic load.
+*/
+
+using trace_clock_t = std::chrono::steady_clock;
+
+struct TraceEvent
+{
+    const char * name;      // string literal
+    double start;           // microseconds
+    double duration;
+    std::int64_t step;      // -1: none
+    std::int64_t domain;    // -1: none
+    std::int64_t subiterations; // Schwarz subiterations of the step, -1: none
+};
+
+class TraceRecorder
+{
+public:
+    static TraceRecorder & instance()
+    {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void enable(const std::string & f0)
+    {
+        fileName_ = f0;
+        origin_ = trace_clock_t::now();
+        buffer();
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    double microseconds(trace_clock_t::time_point tp) const
+    {
+        return std::chrono::duration<double, std::micro>(tp - origin_).count();
+    }
+
+    // the calling thread's events, registered on first use; buffers outlive their threads
+    std::vector<TraceEvent> & buffer()
+    {
+        thread_local std::vector<TraceEvent> * events = nullptr;
+        if (events == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.emplace_back(new std::vector<TraceEvent>);
+            events = buffers_.back().get();
+            events->reserve(4096);
+        }
+        return *events;
+    }
+
+    // call with the worker threads idle, i.e. outside parallel regions
+    void write() const
+    {
+        if (!enabled()) return;
+        std::ofstream fout(fileName_);
+        if (!fout) throw std::runtime_error("Could not open " + fileName_);
+        fout.precision(3);
+        fout << std::fixed << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+        for (std::size_t tid = 0; tid < buffers_.size(); ++tid) {
+            fout << (tid ? ",\n" : "\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+                << tid << ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+        }
+        for (std::size_t tid = 0; tid < buffers_.size(); ++tid) {
+            for (const auto & event : *buffers_[tid]) {
+                // event names are identifiers, nothing to escape
+                fout << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << tid
+                    << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << ", \"args\": {";
+                const char * separator = "";
+                auto write_arg = [&](const char * key, std::int64_t value) {
+                    if (value < 0) return;
+                    fout << separator << "\"" << key << "\": " << value;
+                    separator = ", ";
+                };
+                write_arg("step", event.step);
+                write_arg("domain", event.domain);
+                write_arg("subiterations", event.subiterations);
+                fout << "}}";
+            }
+        }
+        fout << "\n]}\n";
+    }
+
+private:
+    TraceRecorder() = default;
+
+    std::atomic<bool> enabled_{false};
+    std::string fileName_;
+    trace_clock_t::time_point origin_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<std::vector<TraceEvent>>> buffers_;
+};
+
+// one complete event from construction to destruction (or stop())
+class TraceScope
+{
+public:
+    explicit TraceScope(const char * name, std::int64_t step = -1, std::int64_t domain = -1)
+    {
+        if (!TraceRecorder::instance().enabled()) return;
+        event_ = {name, 0.0, 0.0, step, domain, -1};
+        start_ = trace_clock_t::now();
+        active_ = true;
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope & operator=(const TraceScope &) = delete;
+
+    ~TraceScope() { stop(); }
+
+    // before stop(), for spans covering a Schwarz controller step
+    void setSubiterations(std::int64_t subiterations) { event_.subiterations = subiterations; }
+
+    void stop()
+    {
+        if (!active_) return;
+        auto & recorder = TraceRecorder::instance();
+        const auto end = trace_clock_t::now();
+        event_.start = recorder.microseconds(start_);
+        event_.duration = std::chrono::duration<double, std::micro>(end - start_).count();
+        recorder.buffer().push_back(event_);
+        active_ = false;
+    }
+
+private:
+    bool active_ = false;
+    TraceEvent event_ = {};
+    trace_clock_t::time_point start_;
+};
+
+#endif
@@ -0,0 +1,16 @@
+import numpy as np
+
+# Reader for the error histories written by the in-situ error observers (see include/pdas-exp/error_norms.hpp)
+
+
+def load_error_history(infile):
+    """Step, time, and per-variable absolute/relative spatial L2 errors of every evaluated step"""
+
+    nvars = int(np.fromfile(infile, dtype="<u8", count=1)[0])
+    dtype = np.dtype([
+        ("step", "<i8"),
+        ("time", "<f8"),
+        ("abs", "<f8", (nvars,)),
+        ("rel", "<f8", (nvars,)),
+    ])
+    return np.fromfile(infile, dtype=dtype, offset=8)
@@ -0,0 +1,61 @@
+import mmap
+import os
+
+import numpy as np
+
+# Reader for the shared memory live states published by LiveStateObserver (see include/pdas-exp/live_state.hpp)
+
+HEADER_BYTES = 64
+SLOT_HEADER_BYTES = 24
+
+
+class LiveReader:
+    """Attach to a running job's live states, e.g. LiveReader("/pdas_live")"""
+
+    def __init__(self, name="/pdas_live"):
+        with open(os.path.join("/dev/shm", name.lstrip("/")), "rb") as f:
+            self._buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if self._buf[:8] != b"PDASLIVE":
+            raise ValueError(name + " is not a live state segment")
+        self.num_slots = int(np.frombuffer(self._buf, dtype="<u4", count=1, offset=12)[0])
+        num_blocks, self._slot_bytes = np.frombuffer(self._buf, dtype="<u8", count=2, offset=16)
+        self.lengths = [int(n) for n in np.frombuffer(self._buf, dtype="<u8", count=int(num_blocks), offset=HEADER_BYTES)]
+        self._slots_offset = HEADER_BYTES + 8 * len(self.lengths)
+
+    def count(self):
+        """samples published so far"""
+        return int(np.frombuffer(self._buf, dtype="<u8", count=1, offset=32)[0])
+
+    def read(self, n):
+        """(step, time, [block arrays]) of sample n (1-based), or None if it is not available"""
+
+        if n < 1 or n > self.count():
+            return None
+        offset = self._slots_offset + ((n - 1) % self.num_slots) * int(self._slot_bytes)
+        seq_before = int(np.frombuffer(self._buf, dtype="<u8", count=1, offset=offset)[0])
+        if seq_before != 2 * n:
+            return None
+        slot = bytes(self._buf[offset:offset + int(self._slot_bytes)])
+        seq_after = int(np.frombuffer(self._buf, dtype="<u8", count=1, offset=offset)[0])
+        if seq_after != 2 * n:
+            return None
+
+        step = int(np.frombuffer(slot, dtype="<i8", count=1, offset=8)[0])
+        time = float(np.frombuffer(slot, dtype="<f8", count=1, offset=16)[0])
+        blocks, pos = [], SLOT_HEADER_BYTES
+        for length in self.lengths:
+            blocks.append(np.frombuffer(slot, dtype="<f8", count=length, offset=pos).copy())
+            pos += 8 * length
+        return step, time, blocks
+
+    def latest(self, attempts=100):
+        """most recent complete sample, or None if nothing has been published"""
+
+        for _ in range(attempts):
+            n = self.count()
+            if n == 0:
+                return None
+            sample = self.read(n)
+            if sample is not None:
+                return sample
+        return None
@@ -0,0 +1,23 @@
+import numpy as np
+
+# Reader for probe files written by ProbeObserver (see include/pdas-exp/probes.hpp)
+
+
+def load_probes(infile):
+    """(domain, gid) of every probed cell, and the records as a structured array
+
+    gid is local to the domain's mesh; decomposed runs probe a cell in overlapping subdomains once
+
+    record["values"] has shape (ncells, nvars)
+    """
+
+    ncells, nvars = np.fromfile(infile, dtype="<u8", count=2)
+    ncells, nvars = int(ncells), int(nvars)
+    cells = np.fromfile(infile, dtype="<i8", count=2 * ncells, offset=16).reshape((ncells, 2))
+    dtype = np.dtype([
+        ("step", "<i8"),
+        ("time", "<f8"),
+        ("values", "<f8", (ncells, nvars)),
+    ])
+    records = np.fromfile(infile, dtype=dtype, offset=16 + 16 * ncells)
+    return cells, records
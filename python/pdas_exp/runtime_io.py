@@ -0,0 +1,53 @@
+import numpy as np
+
+# Reader for runtime files written by RuntimeObserver (see include/pdas-exp/observer.hpp)
+
+MAGIC = b"PDASRUNT"
+
+# RuntimeObserver::notApplicable: subiters in monolithic runs, nonlinear_iters in decomposed runs
+NOT_APPLICABLE = np.iinfo(np.uint64).max
+
+
+def load_runtime(infile):
+    """Per-step records as a structured array with fields step, subiters, nonlinear_iters, and one field per phase column
+
+    subiters counts Schwarz subiterations and nonlinear_iters Newton / Gauss-Newton iterations;
+    each is NOT_APPLICABLE where the run type has none or, for nonlinear_iters in decomposed runs,
+    cannot see them. Decomposed runs add the columns domain<i> and wait<t>, see column_block.
+    Version 2 files have no nonlinear_iters
+    field, and store subiters as 1 in monolithic runs. Version 1 files, which have no header,
+    give fields subiters and runtime.
+    """
+
+    with open(infile, "rb") as f:
+        data = f.read()
+
+    if data[:8] != MAGIC:
+        dtype = np.dtype([("subiters", "<u8"), ("runtime", "<f8")])
+        return np.frombuffer(data, dtype=dtype)
+
+    version, ncols = np.frombuffer(data, dtype="<u4", count=2, offset=8)
+    if version > 3:
+        raise ValueError(infile + " has unsupported runtime version " + str(version))
+    pos = 16
+    columns = []
+    for _ in range(int(ncols)):
+        length = int(np.frombuffer(data, dtype="<u8", count=1, offset=pos)[0])
+        columns.append(data[pos + 8:pos + 8 + length].decode())
+        pos += 8 + length
+
+    counts = [("step", "<i8"), ("subiters", "<u8")]
+    if version >= 3:
+        counts.append(("nonlinear_iters", "<u8"))
+    dtype = np.dtype(counts + [(name, "<f8") for name in columns])
+    return np.frombuffer(data, dtype=dtype, offset=pos)
+
+
+def column_block(records, prefix):
+    """The columns prefix0, prefix1, ... as an (nsteps, ncolumns) array: with prefix "domain" each
+    subdomain's post-step seconds, with "wait" each thread's barrier waits (NaN outside the team)"""
+
+    names = []
+    while prefix + str(len(names)) in (records.dtype.names or ()):
+        names.append(prefix + str(len(names)))
+    return np.stack([records[name] for name in names], axis=1) if names else np.empty((len(records), 0))
@@ -0,0 +1,164 @@
+import os
+import struct
+
+import numpy as np
+
+# Reader for the "indexed" snapshot format written by StateObserver (see include/pdas-exp/snapshot_io.hpp)
+
+HEADER_MAGIC = b"PDASSNAP"
+INDEX_MAGIC = b"PDASINDX"
+END_MARKER = b"PDASEND\x00"   # follows the data of a preallocated file until it is trimmed
+
+HEADER_FMT = "<8sIIIIQQd"
+BLOCK_FMT = "<QQ"
+RECORD_FMT = "<qdQII"
+INDEX_DTYPE = np.dtype([("step", "<i8"), ("time", "<f8"), ("offset", "<u8")])
+FOOTER_FMT = "<QQ8s"
+
+DTYPES = {1: np.float64, 2: np.float32}
+
+
+def is_snapshot_file(infile):
+    with open(infile, "rb") as f:
+        return f.read(8) == HEADER_MAGIC
+
+
+def read_header(infile):
+    """File header as a dict, plus the list of (length, nvars) per block"""
+
+    with open(infile, "rb") as f:
+        vals = struct.unpack(HEADER_FMT, f.read(struct.calcsize(HEADER_FMT)))
+        assert vals[0] == HEADER_MAGIC, f"{infile} is not an indexed snapshot file"
+        header = {
+            "version": vals[1],
+            "dtype": DTYPES[vals[2]],
+            "codec": vals[3],
+            "layout": vals[4],
+            "sample_freq": vals[6],
+            "dt": vals[7],
+        }
+        blocks = []
+        for _ in range(vals[5]):
+            length, nvars = struct.unpack(BLOCK_FMT, f.read(struct.calcsize(BLOCK_FMT)))
+            blocks.append((length, nvars))
+        header["blocks"] = blocks
+        header["data_offset"] = f.tell()
+
+    return header
+
+
+def read_index(infile, header=None):
+    """Structured array of (step, time, offset) for every record"""
+
+    if header is None:
+        header = read_header(infile)
+
+    fsize = os.path.getsize(infile)
+    footer_size = struct.calcsize(FOOTER_FMT)
+    with open(infile, "rb") as f:
+        f.seek(fsize - footer_size)
+        index_offset, nrecords, magic = struct.unpack(FOOTER_FMT, f.read(footer_size))
+        if (magic == INDEX_MAGIC) and (index_offset + nrecords * INDEX_DTYPE.itemsize + footer_size == fsize):
+            f.seek(index_offset)
+            return np.frombuffer(f.read(nrecords * INDEX_DTYPE.itemsize), dtype=INDEX_DTYPE)
+
+        # no trailing index (e.g. the run was killed), walk the records instead, stopping at the
+        # end marker of an untrimmed preallocated file or at the first torn or implausible record
+        entries = []
+        rec_size = struct.calcsize(RECORD_FMT)
+        nblocks = len(header["blocks"])
+        stored_sizes = None
+        if header["codec"] == 0:
+            itemsize = np.dtype(header["dtype"]).itemsize
+            stored_sizes = [length * itemsize for length, _ in header["blocks"]]
+        prev_step = None
+        pos = header["data_offset"]
+        while pos + rec_size <= fsize:
+            f.seek(pos)
+            raw = f.read(rec_size)
+            if raw[:8] == END_MARKER:
+                break
+            step, time, nbytes, _, _ = struct.unpack(RECORD_FMT, raw)
+            if (nbytes == 0) or (nbytes < 8 * nblocks) or (pos + rec_size + nbytes > fsize):
+                break
+            if (prev_step is not None) and (step <= prev_step):
+                break
+            block_bytes = [int(b) for b in np.frombuffer(f.read(8 * nblocks), dtype="<u8")]
+            if 8 * nblocks + sum(block_bytes) != nbytes:
+                break
+            if (stored_sizes is not None) and (block_bytes != stored_sizes):
+                break
+            entries.append((step, time, pos))
+            prev_step = step
+            pos += rec_size + nbytes
+
+    return np.array(entries, dtype=INDEX_DTYPE)
+
+
+LAYOUT_CELL = 0
+LAYOUT_VARIABLE = 1
+
+
+def _block_offset(infile, idx, block, header, index):
+    nblocks = len(header["blocks"])
+    offset = int(index["offset"][idx]) + struct.calcsize(RECORD_FMT)
+    block_bytes = np.fromfile(infile, dtype="<u8", count=nblocks, offset=offset)
+    return offset + 8 * nblocks + int(np.sum(block_bytes[:block]))
+
+
+def load_snapshot(infile, idx, block=0, header=None, index=None):
+    """Snapshot idx of one block as a flat, cell-interleaved array, only that record is read from disk"""
+
+    if header is None:
+        header = read_header(infile)
+    if index is None:
+        index = read_index(infile, header)
+    assert header["codec"] == 0, "Compressed snapshot files must be decoded first"
+
+    offset = _block_offset(infile, idx, block, header, index)
+    length, nvars = header["blocks"][block]
+    data = np.fromfile(infile, dtype=header["dtype"], count=length, offset=offset)
+    if header["layout"] == LAYOUT_VARIABLE:
+        data = data.reshape((nvars, -1)).T.ravel()
+
+    return data
+
+
+def load_variable(infile, idx, var, block=0, header=None, index=None):
+    """One variable of snapshot idx, one value per cell
+
+    Variable-major files store each variable contiguously, so only its bytes are read.
+    """
+
+    if header is None:
+        header = read_header(infile)
+    if index is None:
+        index = read_index(infile, header)
+    assert header["codec"] == 0, "Compressed snapshot files must be decoded first"
+
+    length, nvars = header["blocks"][block]
+    assert var < nvars, f"Block {block} has {nvars} variables"
+    if header["layout"] != LAYOUT_VARIABLE:
+        return load_snapshot(infile, idx, block, header, index)[var::nvars]
+
+    ncells = length // nvars
+    offset = _block_offset(infile, idx, block, header, index) + var * ncells * np.dtype(header["dtype"]).itemsize
+    return np.fromfile(infile, dtype=header["dtype"], count=ncells, offset=offset)
+
+
+def time_weights(index):
+    """Trapezoidal quadrature weights of each record's time, for irregularly sampled (adaptive) files
+
+    Scaling snapshot k by sqrt(weight[k]) before an SVD makes POD modes approximate the
+    time-continuous ones regardless of where samples cluster.
+    """
+
+    t = np.asarray(index["time"], dtype=np.float64)
+    weights = np.zeros_like(t)
+    if t.size < 2:
+        weights[:] = 1.0
+        return weights
+    dt = np.diff(t)
+    weights[:-1] += 0.5 * dt
+    weights[1:] += 0.5 * dt
+    return weights
@@ -0,0 +1,51 @@
+import numpy as np
+
+# Reader for solver telemetry files written by SolverTelemetryObserver (see include/pdas-exp/solver_telemetry.hpp)
+
+MAGIC = b"PDASSOLV"
+HEADER_BYTES = 16
+
+RECORD_DTYPE = np.dtype([
+    ("step", "<i8"),
+    ("block", "<u4"),
+    ("nonlinear_iters", "<u4"),
+    ("linear_iters_total", "<u4"),
+    ("linear_iters_max", "<u4"),
+    ("rhs_norm_first", "<f8"),
+    ("rhs_norm_last", "<f8"),
+    ("correction_norm_last", "<f8"),
+    ("linear_seconds", "<f8"),
+    ("residual_seconds", "<f8"),
+    ("jacobian_seconds", "<f8"),
+    ("step_seconds", "<f8"),
+])
+
+# version 1 records end after linear_seconds
+RECORD_DTYPE_V1 = np.dtype(RECORD_DTYPE.descr[:9])
+
+
+def load_solver_telemetry(infile):
+    """Per-step records as a structured array, see RECORD_DTYPE; version 1 times it lacks are NaN"""
+
+    with open(infile, "rb") as f:
+        head = f.read(HEADER_BYTES)
+    if head[:8] != MAGIC:
+        raise ValueError(infile + " is not a solver telemetry file")
+    version = int(np.frombuffer(head, dtype="<u4", count=1, offset=8)[0])
+    if version == 2:
+        return np.fromfile(infile, dtype=RECORD_DTYPE, offset=HEADER_BYTES)
+    if version != 1:
+        raise ValueError(infile + " has unsupported solver telemetry version " + str(version))
+    old = np.fromfile(infile, dtype=RECORD_DTYPE_V1, offset=HEADER_BYTES)
+    records = np.empty(old.shape, dtype=RECORD_DTYPE)
+    for name in RECORD_DTYPE.names:
+        records[name] = old[name] if name in RECORD_DTYPE_V1.names else np.nan
+    return records
+
+
+def seconds_per_iteration(records):
+    """Wall time of a step's nonlinear solve over its iterations, NaN for steps without any"""
+
+    iters = records["nonlinear_iters"].astype(np.float64)
+    with np.errstate(divide="ignore", invalid="ignore"):
+        return np.where(iters > 0, records["step_seconds"] / iters, np.nan)
@@ -0,0 +1,31 @@
+import numpy as np
+
+# Reader for Schwarz subiteration histories written by SubiterationRecorder (see include/pdas-exp/subiterations.hpp)
+
+MAGIC = b"PDASSUBI"
+HEADER_BYTES = 40
+
+
+def load_subiterations(infile):
+    """Header values and per-step records, the latter as a structured array with fields
+    step, num_subiters
+
+    This is a count log: the interface residuals the Schwarz controller checks against
+    rel_tol/abs_tol are not recorded. The full state changes of version 1 files are dropped"""
+
+    with open(infile, "rb") as f:
+        head = f.read(HEADER_BYTES)
+    if head[:8] != MAGIC:
+        raise ValueError(infile + " is not a subiteration history file")
+    version, ndomains = (int(val) for val in np.frombuffer(head, dtype="<u4", count=2, offset=8))
+    if version > 2:
+        raise ValueError(infile + " has unsupported subiteration history version " + str(version))
+    rel_tol, abs_tol = np.frombuffer(head, dtype="<f8", count=2, offset=16)
+    conv_step_max = int(np.frombuffer(head, dtype="<i4", count=1, offset=32)[0])
+
+    fields = [("step", "<i8"), ("num_subiters", "<u4"), ("reserved", "<u4")]
+    if version == 1:
+        fields += [("abs_update", "<f8", (ndomains,)), ("rel_update", "<f8", (ndomains,))]
+    records = np.fromfile(infile, dtype=np.dtype(fields), offset=HEADER_BYTES)
+    header = {"ndomains": ndomains, "rel_tol": float(rel_tol), "abs_tol": float(abs_tol), "conv_step_max": conv_step_max}
+    return header, records[["step", "num_subiters"]]
@@ -0,0 +1,59 @@
+// Follows a running job's live states (the "live" input block) without touching its disk output.
+// Prints step, time and the l2 norm of each published block whenever a new sample appears,
+// and exits once the job has finished and removed its shared memory.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "pdas-exp/live_state.hpp"
+
+bool segment_exists(const std::string & name)
+{
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    ::close(fd);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 3) {
+        std::cerr << "Call as: ./live_monitor [name] [pollSeconds]" << std::endl;
+        return 1;
+    }
+    const std::string name = (argc > 1) ? argv[1] : LiveConfig().name;
+    const double pollSeconds = (argc > 2) ? std::atof(argv[2]) : 1.0;
+    const auto pollInterval = std::chrono::duration<double>(pollSeconds > 0.0 ? pollSeconds : 1.0);
+
+    // the segment appears with the job's first sample
+    while (!segment_exists(name)) std::this_thread::sleep_for(pollInterval);
+    LiveStateReader reader(name);
+    std::cout << "Attached to " << name << ": " << reader.numBlocks() << " blocks, "
+        << reader.numSlots() << " slots" << std::endl;
+
+    std::uint64_t lastSeen = 0;
+    std::int64_t step;
+    double time;
+    std::vector<std::vector<double>> blocks;
+    while (true) {
+        if ((reader.count() != lastSeen) && reader.latest(step, time, blocks)) {
+            lastSeen = reader.count();
+            std::cout << "step " << step << " time " << time << " norms";
+            for (const auto & block : blocks) {
+                double sumSq = 0.0;
+                for (const auto val : block) sumSq += val * val;
+                std::cout << " " << std::sqrt(sumSq);
+            }
+            std::cout << std::endl;
+        }
+        else if (!segment_exists(name)) {
+            break;
+        }
+        std::this_thread::sleep_for(pollInterval);
+    }
+    std::cout << "Job finished after " << reader.count() << " samples" << std::endl;
+    return 0;
+}
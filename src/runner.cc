@@ -1,12 +1,101 @@
 // Largely copied from pressio-tutorials
 
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
 
 #include "pda-schwarz/schwarz.hpp"
 #include "pdas-exp/parser.hpp"
 #include "pdas-exp/mono_fom.hpp"
 #include "pdas-exp/mono_lspg.hpp"
 #include "pdas-exp/decomp.hpp"
+#include "pdas-exp/memory.hpp"
+#include "pdas-exp/perf_counters.hpp"
+#include "pdas-exp/timers.hpp"
+#include "pdas-exp/trace.hpp"
+
+#if defined(PDAS_EXP_COUNT_ALLOCATIONS) && defined(__GLIBC__)
+// Heap allocations for memoryFile, counted on their way to glibc's allocator. Hooking malloc rather
+// than operator new also catches Eigen, which allocates through malloc; new ends up here anyway.
+// Every entry point glibc lets a program replace is hooked, so allocations and frees pair up.
+extern "C" {
+
+void * __libc_malloc(std::size_t) noexcept;
+void * __libc_calloc(std::size_t, std::size_t) noexcept;
+void * __libc_realloc(void *, std::size_t) noexcept;
+void * __libc_memalign(std::size_t, std::size_t) noexcept;
+void * __libc_valloc(std::size_t) noexcept;
+void * __libc_pvalloc(std::size_t) noexcept;
+void __libc_free(void *) noexcept;
+
+void * malloc(std::size_t size) noexcept
+{
+    memory_impl::count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void * calloc(std::size_t num, std::size_t size) noexcept
+{
+    memory_impl::count_allocation(num * size);
+    return __libc_calloc(num, size);
+}
+
+// a free of the old block plus a new allocation, whether or not it moves; realloc(ptr, 0) only frees.
+// A failed realloc leaves the old block alone and counts nothing
+void * realloc(void * ptr, std::size_t size) noexcept
+{
+    void * mem = __libc_realloc(ptr, size);
+    if ((ptr != nullptr) && ((mem != nullptr) || (size == 0))) memory_impl::count_free();
+    if (mem != nullptr) memory_impl::count_allocation(size);
+    return mem;
+}
+
+void * aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+    memory_impl::count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void * memalign(std::size_t alignment, std::size_t size) noexcept
+{
+    memory_impl::count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void * valloc(std::size_t size) noexcept
+{
+    memory_impl::count_allocation(size);
+    return __libc_valloc(size);
+}
+
+void * pvalloc(std::size_t size) noexcept
+{
+    memory_impl::count_allocation(size);
+    return __libc_pvalloc(size);
+}
+
+int posix_memalign(void ** ptr, std::size_t alignment, std::size_t size) noexcept
+{
+    if ((alignment % sizeof(void *) != 0) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    memory_impl::count_allocation(size);
+    void * mem = __libc_memalign(alignment, size);
+    if (mem == nullptr) return ENOMEM;
+    *ptr = mem;
+    return 0;
+}
+
+void free(void * ptr) noexcept
+{
+    if (ptr != nullptr) memory_impl::count_free();
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+constexpr bool counts_allocations = true;
+#else
+constexpr bool counts_allocations = false;
+#endif
 
 template<class AppType, class ParserType>
 void dispatch_mono(AppType fomSystem, ParserType & parser)
@@ -29,6 +118,20 @@ void dispatch_mono(AppType fomSystem, ParserType & parser)
     }
 }
 
+// timers, trace and counters are enabled by the input, so reading it is timed by hand
+template<class ParserType>
+void start_profiling(const ParserType & parser, timer_clock_t::time_point parseStart)
+{
+    if (!parser.traceFile().empty()) TraceRecorder::instance().enable(parser.traceFile());
+    if (!parser.perfCountersFile().empty()) PerfCounterRegistry::instance().enable(parser.perfCountersFile());
+    if (!parser.memoryFile().empty()) MemoryRegistry::instance().enable(parser.memoryFile(), counts_allocations);
+    if (parser.timersFile().empty()) return;
+    auto & registry = TimerRegistry::instance();
+    registry.enable(parser.timersFile());
+    const std::chrono::duration<double> elapsed = timer_clock_t::now() - parseStart;
+    registry.add("parse", elapsed.count());
+}
+
 template<class AppType, class ParserType>
 void dispatch_decomp(ParserType & parser)
 {
@@ -59,6 +162,7 @@ int main(int argc, char *argv[])
     namespace pode = pressio::ode;
     using scalar_t = double;
 
+    const auto parseStart = timer_clock_t::now();
     const auto inputFile = check_and_get_inputfile(argc, argv);
     auto node = YAML::LoadFile(inputFile);
 
@@ -70,17 +174,26 @@ int main(int argc, char *argv[])
     // TODO: need to incorporate physical parameter settings
     if (eqsName == "2d_swe") {
         Parser2DSwe<scalar_t> parser(node);
+        start_profiling(parser, parseStart);
 
         if (parser.isDecomp()) {
             using app_t = pdas::swe2d_app_type;
             dispatch_decomp<app_t>(parser);
         }
         else {
+            ScopedTimer meshTimer("mesh");
+            MemoryScope meshMemory("mesh");
             const auto meshObj = pda::load_cellcentered_uniform_mesh_eigen<scalar_t>(parser.meshDirFull());
+            meshMemory.stop();
+            meshTimer.stop();
+            ScopedTimer problemTimer("problem");
+            MemoryScope problemMemory("problem");
             auto fomSystem = pda::create_problem_eigen(
                 meshObj, parser.probId(), parser.fluxOrder(),
                 parser.icFlag(), parser.userParams()
             );
+            problemMemory.stop();
+            problemTimer.stop();
 
             dispatch_mono(fomSystem, parser);
         }
@@ -88,17 +201,26 @@ int main(int argc, char *argv[])
     }
     else if (eqsName == "2d_euler") {
         Parser2DEuler<scalar_t> parser(node);
+        start_profiling(parser, parseStart);
 
         if (parser.isDecomp()) {
             using app_t = pdas::euler2d_app_type;
             dispatch_decomp<app_t>(parser);
         }
         else {
+            ScopedTimer meshTimer("mesh");
+            MemoryScope meshMemory("mesh");
             const auto meshObj = pda::load_cellcentered_uniform_mesh_eigen<scalar_t>(parser.meshDirFull());
+            meshMemory.stop();
+            meshTimer.stop();
+            ScopedTimer problemTimer("problem");
+            MemoryScope problemMemory("problem");
             auto fomSystem = pda::create_problem_eigen(
                 meshObj, parser.probId(), parser.fluxOrder(),
                 parser.icFlag(), parser.userParams()
             );
+            problemMemory.stop();
+            problemTimer.stop();
 
             dispatch_mono(fomSystem, parser);
         }
@@ -106,17 +228,26 @@ int main(int argc, char *argv[])
     }
     else if (eqsName == "2d_burgers") {
         Parser2DBurgers<scalar_t> parser(node);
+        start_profiling(parser, parseStart);
 
         if (parser.isDecomp()) {
             using app_t = pdas::burgers2d_app_type;
             dispatch_decomp<app_t>(parser);
         }
         else {
+            ScopedTimer meshTimer("mesh");
+            MemoryScope meshMemory("mesh");
             const auto meshObj = pda::load_cellcentered_uniform_mesh_eigen<scalar_t>(parser.meshDirFull());
+            meshMemory.stop();
+            meshTimer.stop();
+            ScopedTimer problemTimer("problem");
+            MemoryScope problemMemory("problem");
             auto fomSystem = pda::create_problem_eigen(
                 meshObj, parser.probId(), parser.fluxOrder(),
                 parser.icFlag(), parser.userParams()
             );
+            problemMemory.stop();
+            problemTimer.stop();
 
             dispatch_mono(fomSystem, parser);
         }
@@ -126,5 +257,9 @@ int main(int argc, char *argv[])
         throw std::runtime_error("Invalid 'equations': " + eqsName);
     }
 
+    TimerRegistry::instance().write();
+    TraceRecorder::instance().write();
+    PerfCounterRegistry::instance().write();
+    MemoryRegistry::instance().write();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+// Expands an indexed (possibly compressed) snapshot file for downstream tools,
+// e.g. POD basis generation which reads plain streams of doubles.
+// Single-precision files are widened to double when writing the raw format.
+
+#include <iostream>
+#include <type_traits>
+
+#include "pdas-exp/snapshot_io.hpp"
+
+template<class ScalarType, class OutType = ScalarType>
+void decode_all(SnapshotReader & reader, SnapshotFileWriter & writer)
+{
+    const auto numBlocks = reader.numBlocks();
+    std::vector<std::vector<ScalarType>> data(numBlocks);
+    std::vector<std::vector<OutType>> outData(numBlocks);
+    for (std::size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+        data[blockIdx].resize(reader.vectorLength(blockIdx));
+    }
+
+    std::vector<std::pair<const char *, std::size_t>> blocks(numBlocks);
+    for (std::size_t k = 0; k < reader.numSnapshots(); ++k) {
+        for (std::size_t blockIdx = 0; blockIdx < numBlocks; ++blockIdx) {
+            reader.read(k, data[blockIdx].data(), blockIdx);
+            const OutType * out = reinterpret_cast<const OutType *>(data[blockIdx].data());
+            if (!std::is_same<ScalarType, OutType>::value) {
+                outData[blockIdx].assign(data[blockIdx].begin(), data[blockIdx].end());
+                out = outData[blockIdx].data();
+            }
+            blocks[blockIdx] = {reinterpret_cast<const char *>(out), data[blockIdx].size()};
+        }
+        writer.write(reader.step(k), reader.time(k), blocks, sizeof(OutType));
+    }
+    writer.close();
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc < 3) || (argc > 4)) {
+        std::cerr << "Call as: ./snapshot_decode <infile> <outfile> [raw|indexed]" << std::endl;
+        return 1;
+    }
+
+    SnapshotConfig config;
+    config.format = (argc == 4) ? string_to_snapshot_format(argv[3]) : SnapshotFormat::Raw;
+
+    SnapshotReader reader(argv[1]);
+    std::vector<int> nvarsVec;
+    for (std::size_t blockIdx = 0; blockIdx < reader.numBlocks(); ++blockIdx) {
+        nvarsVec.push_back(static_cast<int>(reader.nvars(blockIdx)));
+    }
+    SnapshotFileWriter writer(argv[2], config, nvarsVec, reader.sampleFreq(), reader.dt());
+
+    if (reader.scalarSize() == sizeof(double)) decode_all<double>(reader, writer);
+    else if (config.format == SnapshotFormat::Raw) decode_all<float, double>(reader, writer);
+    else decode_all<float>(reader, writer);
+
+    if (reader.codec() == SnapshotCodecType::Lossy) {
+        for (std::size_t blockIdx = 0; blockIdx < reader.numBlocks(); ++blockIdx) {
+            std::cout << "Block " << blockIdx << " max abs error per variable:";
+            for (const auto err : reader.achievedError(blockIdx)) std::cout << " " << err;
+            std::cout << std::endl;
+        }
+    }
+    std::cout << "Decoded " << reader.numSnapshots() << " snapshots to " << argv[2] << std::endl;
+    return 0;
+}
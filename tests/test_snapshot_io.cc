@@ -0,0 +1,238 @@
+// Round trips through SnapshotFileWriter and SnapshotReader, run by ctest.
+// Exits nonzero if any check fails; checks do not use assert, so they also run in Release builds.
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pdas-exp/snapshot_io.hpp"
+
+namespace {
+
+int numFailures = 0;
+
+void check(bool passed, const std::string & what)
+{
+    if (passed) return;
+    std::cerr << "FAILED: " << what << std::endl;
+    ++numFailures;
+}
+
+constexpr int numRecords = 20;
+constexpr int numCells = 50;
+
+// cell-interleaved state of nvars variables, smooth in space and time
+std::vector<double> make_state(int step, int nvars, double offset = 0.0)
+{
+    std::vector<double> state(static_cast<std::size_t>(numCells) * nvars);
+    for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
+        for (int varIdx = 0; varIdx < nvars; ++varIdx) {
+            state[cellIdx * nvars + varIdx] = offset + varIdx + std::sin(0.1 * cellIdx + 0.05 * step + varIdx);
+        }
+    }
+    return state;
+}
+
+SnapshotConfig indexed_config()
+{
+    SnapshotConfig config;
+    config.format = SnapshotFormat::Indexed;
+    config.expectedRecords = numRecords;
+    return config;
+}
+
+// writes numRecords records of one block per entry of nvarsVec, step k at time 0.1 k
+void write_file(const std::string & fileName, const SnapshotConfig & config, const std::vector<int> & nvarsVec)
+{
+    SnapshotFileWriter writer(fileName, config, nvarsVec, 1, 0.1);
+    for (int step = 0; step < numRecords; ++step) {
+        std::vector<std::vector<double>> states;
+        std::vector<std::pair<const char *, std::size_t>> blocks;
+        for (std::size_t blockIdx = 0; blockIdx < nvarsVec.size(); ++blockIdx) {
+            states.push_back(make_state(step, nvarsVec[blockIdx], 10.0 * blockIdx));
+        }
+        for (const auto & state : states) {
+            blocks.emplace_back(reinterpret_cast<const char *>(state.data()), state.size());
+        }
+        writer.write(step, 0.1 * step, blocks, sizeof(double));
+    }
+}
+
+// largest pointwise difference between the stored records and the states written
+double max_read_error(SnapshotReader & reader, const std::vector<int> & nvarsVec)
+{
+    double maxError = 0.0;
+    for (std::size_t k = 0; k < reader.numSnapshots(); ++k) {
+        for (std::size_t blockIdx = 0; blockIdx < nvarsVec.size(); ++blockIdx) {
+            const auto expected = make_state(static_cast<int>(k), nvarsVec[blockIdx], 10.0 * blockIdx);
+            std::vector<double> stored(reader.vectorLength(blockIdx));
+            reader.read(k, stored.data(), blockIdx);
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                maxError = std::max(maxError, std::abs(stored[i] - expected[i]));
+            }
+        }
+    }
+    return maxError;
+}
+
+void check_records(SnapshotReader & reader, const std::vector<int> & nvarsVec, const std::string & name)
+{
+    if (reader.numSnapshots() != numRecords) {
+        check(false, name + ": " + std::to_string(reader.numSnapshots()) + " records instead of " + std::to_string(numRecords));
+        return;
+    }
+    check(reader.numBlocks() == nvarsVec.size(), name + ": block count");
+    for (std::size_t blockIdx = 0; blockIdx < nvarsVec.size(); ++blockIdx) {
+        check(reader.nvars(blockIdx) == static_cast<std::size_t>(nvarsVec[blockIdx]), name + ": nvars");
+        check(reader.vectorLength(blockIdx) == static_cast<std::size_t>(numCells * nvarsVec[blockIdx]), name + ": vector length");
+    }
+    for (std::size_t k = 0; k < reader.numSnapshots(); ++k) {
+        check(reader.step(k) == static_cast<std::int64_t>(k), name + ": step of record " + std::to_string(k));
+    }
+}
+
+void test_lossless()
+{
+    const std::string fileName = "test_lossless.bin";
+    const std::vector<int> nvarsVec = {3, 4};
+    auto config = indexed_config();
+    config.codec = SnapshotCodecType::Lossless;
+    config.keyframeInterval = 8;
+    write_file(fileName, config, nvarsVec);
+
+    SnapshotReader reader(fileName);
+    check_records(reader, nvarsVec, "lossless");
+    check(max_read_error(reader, nvarsVec) == 0.0, "lossless: records differ from the states written");
+    // out of order, from the closest keyframe
+    std::vector<double> stored(reader.vectorLength(1));
+    reader.read(13, stored.data(), 1);
+    check(stored == make_state(13, 4, 10.0), "lossless: record read out of order");
+    std::remove(fileName.c_str());
+}
+
+void test_lossy()
+{
+    const std::string fileName = "test_lossy.bin";
+    const std::vector<int> nvarsVec = {3};
+    const double bound = 1e-4;
+    auto config = indexed_config();
+    config.codec = SnapshotCodecType::Lossy;
+    config.errorBound = bound;
+    config.errorBoundMode = ErrorBoundMode::Absolute;
+    write_file(fileName, config, nvarsVec);
+
+    SnapshotReader reader(fileName);
+    check_records(reader, nvarsVec, "lossy");
+    const double maxError = max_read_error(reader, nvarsVec);
+    check(maxError <= bound, "lossy: error " + std::to_string(maxError) + " above the bound");
+    for (const auto error : reader.achievedError()) {
+        check(error <= bound, "lossy: reported error above the bound");
+    }
+    std::remove(fileName.c_str());
+}
+
+void test_variable_major()
+{
+    const std::string fileName = "test_variable_major.bin";
+    const std::vector<int> nvarsVec = {4};
+    auto config = indexed_config();
+    config.layout = SnapshotLayout::VariableMajor;
+    write_file(fileName, config, nvarsVec);
+
+    SnapshotReader reader(fileName);
+    check_records(reader, nvarsVec, "variable-major");
+    check(reader.layout() == SnapshotLayout::VariableMajor, "variable-major: layout");
+    // read() gives the cell-interleaved state back
+    check(max_read_error(reader, nvarsVec) == 0.0, "variable-major: records differ from the states written");
+    const auto expected = make_state(7, 4);
+    const double * var2 = reader.variable<double>(7, 2);
+    bool contiguous = true;
+    for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
+        contiguous = contiguous && (var2[cellIdx] == expected[cellIdx * 4 + 2]);
+    }
+    check(contiguous, "variable-major: variable view");
+    std::remove(fileName.c_str());
+}
+
+void test_preallocated()
+{
+    const std::string fileName = "test_preallocated.bin";
+    const std::vector<int> nvarsVec = {3};
+    auto config = indexed_config();
+    config.preallocate = true;
+    config.expectedRecords = 2 * numRecords;    // closed with room to spare
+    write_file(fileName, config, nvarsVec);
+
+    SnapshotReader reader(fileName);
+    check_records(reader, nvarsVec, "preallocated");
+    check(max_read_error(reader, nvarsVec) == 0.0, "preallocated: records differ from the states written");
+    std::remove(fileName.c_str());
+}
+
+// a run killed while writing: the writer is never closed, so the file has no index
+// and is zero-filled past the last record
+void test_crashed_preallocated()
+{
+    const std::string fileName = "test_crashed.bin";
+    const std::vector<int> nvarsVec = {3};
+    auto config = indexed_config();
+    config.preallocate = true;
+    config.expectedRecords = 5 * numRecords;
+
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        // the mapped pages reach the file without the writer's destructor running
+        auto * writer = new SnapshotFileWriter(fileName, config, nvarsVec, 1, 0.1);
+        for (int step = 0; step < numRecords; ++step) {
+            const auto state = make_state(step, nvarsVec[0]);
+            writer->write(step, 0.1 * step, {{reinterpret_cast<const char *>(state.data()), state.size()}}, sizeof(double));
+        }
+        ::_exit(0);
+    }
+    int status = 0;
+    check((pid > 0) && (::waitpid(pid, &status, 0) == pid) && WIFEXITED(status), "crashed: writer process");
+
+    {
+        SnapshotReader reader(fileName);
+        check_records(reader, nvarsVec, "crashed");
+        check(max_read_error(reader, nvarsVec) == 0.0, "crashed: records differ from the states written");
+    }
+
+    // killed between a record and its end marker: the walk stops at the zeros
+    {
+        const long recordBytes = sizeof(snapfmt::RecordHeader) + sizeof(std::uint64_t) + numCells * 3 * sizeof(double);
+        const long markerOffset = sizeof(snapfmt::FileHeader) + sizeof(snapfmt::BlockInfo) + numRecords * recordBytes;
+        std::FILE * file = std::fopen(fileName.c_str(), "r+b");
+        const char zeros[sizeof(MappedSink::endMarker)] = {};
+        check((file != nullptr) && (std::fseek(file, markerOffset, SEEK_SET) == 0)
+            && (std::fwrite(zeros, sizeof(zeros), 1, file) == 1), "crashed: clearing the end marker");
+        if (file) std::fclose(file);
+
+        SnapshotReader reader(fileName);
+        check_records(reader, nvarsVec, "crashed, no end marker");
+    }
+    std::remove(fileName.c_str());
+}
+
+}
+
+int main()
+{
+    test_lossless();
+    test_lossy();
+    test_variable_major();
+    test_preallocated();
+    test_crashed_preallocated();
+
+    if (numFailures > 0) {
+        std::cerr << numFailures << " snapshot I/O checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "snapshot I/O checks passed" << std::endl;
+    return 0;
+}